@@ -4,7 +4,19 @@
 #include "config.h"
 #endif
 
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#include <stddef.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "elinks.h"
 
@@ -123,18 +135,11 @@ find_in_cache(struct uri *uri)
 	return NULL;
 }
 
-struct cache_entry *
-get_cache_entry(struct uri *uri)
+static struct cache_entry *
+init_cache_entry(struct uri *uri)
 {
-	struct cache_entry *cached = find_in_cache(uri);
+	struct cache_entry *cached = mem_calloc(1, sizeof(*cached));
 
-	assertm(!uri->fragment, "Fragment in URI (%s)", struri(uri));
-
-	if (cached) return cached;
-
-	shrink_memory(0);
-
-	cached = mem_calloc(1, sizeof(*cached));
 	if (!cached) return NULL;
 
 	cached->uri = get_proxied_uri(uri);
@@ -163,6 +168,33 @@ get_cache_entry(struct uri *uri)
 	return cached;
 }
 
+struct cache_entry *
+get_cache_entry(struct uri *uri)
+{
+	struct cache_entry *cached = find_in_cache(uri);
+
+	assertm(!uri->fragment, "Fragment in URI (%s)", struri(uri));
+
+	if (cached) return cached;
+
+	shrink_memory(0);
+
+	return init_cache_entry(uri);
+}
+
+struct cache_entry *
+get_private_cache_entry(struct uri *uri)
+{
+	struct cache_entry *cached;
+
+	shrink_memory(0);
+
+	cached = init_cache_entry(uri);
+	if (cached) cached->valid = 0;
+
+	return cached;
+}
+
 static int
 cache_entry_has_expired(struct cache_entry *cached)
 {
@@ -173,6 +205,27 @@ cache_entry_has_expired(struct cache_entry *cached)
 	return timeval_cmp(&cached->max_age, &now) <= 0;
 }
 
+/* Whether the local file mapped into @cached was modified since. */
+static int
+mapped_file_changed(struct cache_entry *cached)
+{
+	struct string name;
+	struct stat st;
+	int changed = 1;
+
+	if (!init_string(&name)) return 1;
+
+	if (add_uri_to_string(&name, cached->uri, URI_PATH)) {
+		decode_uri_string(&name);
+		changed = stat(name.source, &st)
+			  || st.st_mtime != cached->file_mtime
+			  || st.st_size != cached->file_size;
+	}
+
+	done_string(&name);
+	return changed;
+}
+
 struct cache_entry *
 get_validated_cache_entry(struct uri *uri, enum cache_mode cache_mode)
 {
@@ -194,7 +247,10 @@ get_validated_cache_entry(struct uri *uri, enum cache_mode cache_mode)
 	 * --jonas */
 	if ((cached->cache_mode == CACHE_MODE_NEVER && cache_mode != CACHE_MODE_ALWAYS)
 	    || (cached->redirect && !get_opt_bool("document.cache.cache_redirects", NULL))
-	    || (cached->expire && cache_entry_has_expired(cached))) {
+	    || (cached->expire && cache_entry_has_expired(cached))
+	    || (!list_empty(cached->frag)
+		&& ((struct fragment *) cached->frag.next)->mapped
+		&& mapped_file_changed(cached))) {
 		if (!is_object_used(cached)) delete_cache_entry(cached);
 		return NULL;
 	}
@@ -269,8 +325,7 @@ enlarge_entry(struct cache_entry *cached, off_t size)
 
 #define CACHE_PAD(x) (((x) | 0x3fff) + 1)
 
-/* One byte is reserved for data in struct fragment. */
-#define FRAGSIZE(x) (sizeof(struct fragment) + (x) - 1)
+#define FRAGSIZE(x) (offsetof(struct fragment, inline_data) + (x))
 
 /* We store the fragments themselves in a private vault, safely separated from
  * the rest of memory structures. If we lived in the main libc memory pool, we
@@ -302,19 +357,64 @@ frag_alloc(size_t size)
 
 	if (!f) return NULL;
 	memset(f, 0, FRAGSIZE(size));
+	f->data = f->inline_data;
 	return f;
 }
 
+static void
+frag_free(struct fragment *f)
+{
+#ifdef HAVE_MMAP
+	if (f->mapped) {
+		munmap(f->data, f->real_length);
+		close(f->fd);
+		mem_free(f);
+		return;
+	}
+#endif
+	mem_mmap_free(f, FRAGSIZE(f->real_length));
+}
+
+/* A mapped fragment is read-only, so reallocating it also turns it into
+ * a copy that can be written to. The caller relinks the fragment. */
 static struct fragment *
 frag_realloc(struct fragment *f, size_t size)
 {
-	return mem_mmap_realloc(f, FRAGSIZE(f->real_length), FRAGSIZE(size));
+	struct fragment *nf;
+
+	if (f->mapped) {
+		nf = frag_alloc(size);
+		if (!nf) return NULL;
+
+		nf->next = f->next;
+		nf->prev = f->prev;
+		nf->offset = f->offset;
+		nf->length = (off_t) size < f->length ? (off_t) size : f->length;
+		nf->real_length = size;
+		memcpy(nf->data, f->data, nf->length);
+		frag_free(f);
+		return nf;
+	}
+
+	nf = mem_mmap_realloc(f, FRAGSIZE(f->real_length), FRAGSIZE(size));
+	if (nf) nf->data = nf->inline_data;
+	return nf;
 }
 
-static void
-frag_free(struct fragment *f)
+/* Gets @f ready to be written to in place. */
+static struct fragment *
+frag_unmap(struct fragment *f)
 {
-	mem_mmap_free(f, FRAGSIZE(f->real_length));
+	struct fragment *nf;
+
+	if (!f->mapped) return f;
+
+	nf = frag_realloc(f, f->length);
+	if (!nf) return NULL;
+
+	nf->next->prev = nf;
+	nf->prev->next = nf;
+	return nf;
 }
 
 
@@ -421,6 +521,9 @@ add_fragment(struct cache_entry *cached, off_t offset,
 
 		} /* else We are subset of original fragment. */
 
+		f = frag_unmap(f);
+		if (!f) return -1;
+
 		/* Copy the stuff over there. */
 		memcpy(f->data + offset - f->offset, data, length);
 
@@ -465,6 +568,69 @@ add_fragment(struct cache_entry *cached, off_t offset,
 	return 1;
 }
 
+int
+add_file_fragment(struct cache_entry *cached, int fd, off_t size,
+		  time_t mtime)
+{
+#ifdef HAVE_MMAP
+	struct fragment *f;
+	void *data;
+
+	if (size <= 0 || (off_t) (size_t) size != size)
+		return -1;
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+		return -1;
+
+	f = mem_calloc(1, sizeof(*f));
+	if (!f) {
+		munmap(data, size);
+		return -1;
+	}
+
+	delete_entry_content(cached);
+
+#if defined(F_GETFD) && defined(FD_CLOEXEC)
+	/* It stays open, but not in the programs we start. */
+	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+#endif
+
+	f->length = f->real_length = size;
+	f->data = data;
+	f->fd = fd;
+	f->mapped = 1;
+	add_to_list(cached->frag, f);
+
+	enlarge_entry(cached, size);
+	cached->length = size;
+	cached->file_mtime = mtime;
+	cached->file_size = size;
+
+	dump_frags(cached, "add_file_fragment");
+
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/* Reading the mapping of a local file past its end raises SIGBUS, so if
+ * the file shrank since it was mapped as @f, only what is left of it is
+ * kept, as a copy. */
+static void
+check_file_fragment(struct cache_entry *cached, struct fragment *f)
+{
+	struct stat st;
+
+	if (fstat(f->fd, &st) || st.st_size >= f->length)
+		return;
+
+	truncate_entry(cached, st.st_size, 1);
+	cached->cache_id = id_counter++;
+}
+
+
 /* Try to defragment the cache entry. Defragmentation will not be possible
  * if there is a gap in the fragments; if we have bytes 1-100 in one fragment
  * and bytes 201-300 in the second, we must leave those two fragments separate
@@ -486,6 +652,13 @@ get_cache_fragment(struct cache_entry *cached)
 		return NULL;
 
 	first_frag = cached->frag.next;
+	if (first_frag->mapped) {
+		check_file_fragment(cached, first_frag);
+		if (list_empty(cached->frag))
+			return NULL;
+		first_frag = cached->frag.next;
+	}
+
 	if (first_frag->offset)
 		return NULL;
 
@@ -623,6 +796,9 @@ free_entry_to(struct cache_entry *cached, off_t offset)
 		} else if (f->offset < offset) {
 			off_t size = offset - f->offset;
 
+			f = frag_unmap(f);
+			if (!f) break;
+
 			enlarge_entry(cached, -size);
 			f->length -= size;
 			memmove(f->data, f->data + size, f->length);
@@ -673,6 +849,9 @@ done_cache_entry(struct cache_entry *cached)
 	mem_free_if(cached->ssl_info);
 	mem_free_if(cached->encoding_info);
 	mem_free_if(cached->etag);
+#ifdef CONFIG_QUICKJS
+	mem_free_if(cached->bytecode);
+#endif
 
 	mem_free(cached);
 }
@@ -780,7 +959,8 @@ garbage_collection(int whole)
 	/* The maximal cache size tolerated by user. Note that this is only
 	 * size of the "just stored" unused cache entries, used cache entries
 	 * are not counted to that. */
-	unsigned longlong opt_cache_size = get_opt_long("document.cache.memory.size", NULL);
+	static struct option_handle cache_size_opt = INIT_OPTION_HANDLE("document.cache.memory.size");
+	unsigned longlong opt_cache_size = get_opt_long_handle(&cache_size_opt);
 	/* The low-treshold cache size. Basically, when the cache size is
 	 * higher than opt_cache_size, we free the cache so that there is no
 	 * more than this value in the cache anymore. This is to make sure we
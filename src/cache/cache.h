@@ -57,6 +57,14 @@ struct cache_entry {
 #ifdef CONFIG_SCRIPTING_SPIDERMONKEY
 	struct JSObject *jsobject;      /* Instance of cache_entry_class */
 #endif
+#ifdef CONFIG_QUICKJS
+	unsigned char *bytecode;	/* Compiled script, if it is one */
+	size_t bytecode_length;
+	unsigned int bytecode_cache_id;	/* The @cache_id it was compiled from */
+#endif
+
+	time_t file_mtime;		/* Of the local file mapped as data */
+	off_t file_size;
 
 	timeval_T max_age;		/* Expiration time */
 
@@ -81,7 +89,16 @@ struct fragment {
 	off_t offset;
 	off_t length;
 	off_t real_length;
-	char data[1]; /* Must be last */
+
+	/* Points to @inline_data, or to a read-only mapping of a local file
+	 * if @mapped is set. */
+	char *data;
+	unsigned int mapped:1;
+
+	/* The mapped file, kept open to notice it shrinking */
+	int fd;
+
+	char inline_data[1]; /* Must be last */
 };
 
 
@@ -93,6 +110,10 @@ struct cache_entry *find_in_cache(struct uri *uri);
  * NULL if allocation fails. */
 struct cache_entry *get_cache_entry(struct uri *uri);
 
+/* Adds a new entry that find_in_cache() never returns, for a connection
+ * loading only a part of the document. Returns NULL if allocation fails. */
+struct cache_entry *get_private_cache_entry(struct uri *uri);
+
 /* Searches the cache for a matching entry and checks if it is still valid and
  * usable. Returns NULL if the @cache_mode suggests to reload it again. */
 struct cache_entry *get_validated_cache_entry(struct uri *uri, enum cache_mode cache_mode);
@@ -116,6 +137,14 @@ struct cache_entry *get_redirected_cache_entry(struct uri *uri);
 int add_fragment(struct cache_entry *cached, off_t offset,
 		 const char *data, ssize_t length);
 
+/* Replaces the data of the cache entry with a read-only mapping of the
+ * @size bytes of the local file open as @fd, last modified at @mtime. The
+ * entry is dropped from the cache once the file changes. Returns -1 if the
+ * file could not be mapped, 0 otherwise, in which case @fd is closed along
+ * with the mapping. */
+int add_file_fragment(struct cache_entry *cached, int fd, off_t size,
+		      time_t mtime);
+
 /* Defragments the cache entry and returns the resulting fragment containing the
  * complete source of all currently downloaded fragments. Returns NULL if
  * validation of the fragments fails. */
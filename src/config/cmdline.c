@@ -863,6 +863,29 @@ union option_info cmdline_options_info[] = {
 		"dump-color-mode", 0, "document.dump.color_mode",
 		N_("Color mode used with -dump.")),
 
+	INIT_OPT_CMDALIAS("", N_("Number of URLs loaded at once with -dump"),
+		"dump-parallel", 0, "document.dump.parallel",
+		N_("Number of URLs loaded at the same time with -dump "
+		"and -source.")),
+
+	INIT_OPT_BOOL("", N_("Run a dump server"),
+		"dump-server", 0, 0,
+		N_("Keep running and serve dump requests on a socket in the "
+		"ELinks home directory, keeping the document cache, DNS "
+		"cache and keep-alive connections warm between requests. "
+		"Each request is one line holding the URL, optionally "
+		"followed by the width, codepage and color mode, separated "
+		"by tabs. The reply is a status line, \"OK\" or \"ERROR "
+		"<message>\", followed by the dump. Plain text is sent as "
+		"it loads, and the connection is closed early if loading "
+		"then fails.")),
+
+	INIT_OPT_BOOL("", N_("Send dumps to a running dump server"),
+		"dump-use-server", 0, 0,
+		N_("Have the URLs given with -dump formatted by a running "
+		"dump server (see -dump-server) instead of starting up "
+		"completely. Dumps locally if there is no server.")),
+
 	INIT_OPT_CMDALIAS("", N_("Width of document formatted with -dump"),
 		"dump-width", 0, "document.dump.width",
 		N_("Width of the dump output.")),
@@ -30,6 +30,7 @@
 #include "terminal/terminal.h"
 #include "util/color.h"
 #include "util/error.h"
+#include "util/hash.h"
 #include "util/memory.h"
 #include "util/string.h"
 #include "viewer/text/draw.h"
@@ -253,6 +254,104 @@ get_opt_rec_real(struct option *tree, const char *name)
 	return opt;
 }
 
+/* Options already resolved from their dotted names, so that the
+ * get_opt_*() macros do not crawl the tree on each call. The key is the
+ * address of the tree followed by the name. Any deleted option flushes
+ * the whole cache and bumps the generation, which also invalidates all
+ * the option handles. */
+static struct hash *option_lookup_cache;
+int option_handle_generation = 1;
+
+static long option_lookup_count;
+static long option_crawl_count;
+
+static void
+flush_option_lookup_cache(void)
+{
+	struct hash_item *item;
+	int i;
+
+	option_handle_generation++;
+
+	if (!option_lookup_cache) return;
+
+	foreach_hash_item (item, *option_lookup_cache, i) {
+		mem_free_if((char *) item->key);
+	}
+
+	free_hash(&option_lookup_cache);
+}
+
+/** Like get_opt_rec(), but looks the name up in the hash of already
+ * resolved options first. */
+static struct option *
+get_opt_rec_cached(struct option *tree, const char *name)
+{
+	struct option *opt;
+	struct hash_item *item;
+	char keybuf[MAX_STR_LEN];
+	int keylen = sizeof(tree) + strlen(name);
+	char *key;
+
+	option_lookup_count++;
+
+	if (!option_lookup_cache) {
+		option_lookup_cache = init_hash8();
+	}
+
+	if (!option_lookup_cache || keylen > sizeof(keybuf)) {
+		option_crawl_count++;
+		return get_opt_rec(tree, name);
+	}
+
+	memcpy(keybuf, &tree, sizeof(tree));
+	memcpy(keybuf + sizeof(tree), name, keylen - sizeof(tree));
+
+	item = get_hash_item(option_lookup_cache, keybuf, keylen);
+	if (item) return (struct option *) item->value;
+
+	option_crawl_count++;
+	opt = get_opt_rec(tree, name);
+	if (!opt) return NULL;
+
+	key = memacpy(keybuf, keylen);
+	if (key && !add_hash_item(option_lookup_cache, key, keylen, opt))
+		mem_free(key);
+
+	return opt;
+}
+
+/** Resolve @a handle to the option of the main tree it names. Use the
+ * get_opt_handle() macro, which only gets here when the handle has not
+ * been resolved yet or some options were deleted since then.
+ * @relates option_handle */
+struct option *
+resolve_option_handle(struct option_handle *handle)
+{
+	struct option *opt = get_opt_rec_cached(config_options, handle->name);
+
+	if (!opt) INTERNAL("Attempted to fetch nonexisting option %s!", handle->name);
+
+	handle->option = opt;
+	handle->generation = option_handle_generation;
+
+	return opt;
+}
+
+/** Number of string-path option lookups done so far. */
+long
+get_option_lookup_count(void)
+{
+	return option_lookup_count;
+}
+
+/** Number of those lookups that had to crawl the options tree. */
+long
+get_option_crawl_count(void)
+{
+	return option_crawl_count;
+}
+
 /** If @a opt is an alias, return the option to which it refers.
  *
  * @warning Because the alias may have the ::OPT_ALIAS_NEGATE flag,
@@ -301,7 +400,7 @@ get_opt_(
 
 	/* Else, return the real option. */
 	if (!opt)
-		opt = get_opt_rec(tree, name);
+		opt = get_opt_rec_cached(tree, name);
 
 #ifdef CONFIG_DEBUG
 	errfile = file;
@@ -616,6 +715,8 @@ done_option(struct option *option)
 static void
 delete_option_do(struct option *option, int recursive)
 {
+	flush_option_lookup_cache();
+
 	if (option->next) {
 		del_from_list(option);
 		option->prev = option->next = NULL;
@@ -330,6 +330,39 @@ extern union option_value *get_opt_(struct option *, const char *, struct sessio
 #define get_cmd_opt_color(name) get_opt_color_tree(cmdline_options, name, NULL)
 #define get_cmd_opt_tree(name) get_opt_tree_tree(cmdline_options, name, NULL)
 
+/** A dotted name of an option in the main tree resolved once, so that
+ * reading the option in hot paths is just a pointer dereference. The
+ * handle is resolved again whenever any option has been deleted since.
+ * Session and domain shadows are not looked at, so use it only where
+ * the get_opt_*() macros would be passed a NULL session.
+ *
+ * Declare it as static struct option_handle h = INIT_OPTION_HANDLE("a.b");
+ * and read it with get_opt_bool_handle(&h) and friends. */
+struct option_handle {
+	const char *name;
+	struct option *option;
+	int generation;
+};
+
+#define INIT_OPTION_HANDLE(name) { name, NULL, 0 }
+
+extern int option_handle_generation;
+struct option *resolve_option_handle(struct option_handle *);
+
+#define get_opt_handle(handle) \
+	((handle)->generation == option_handle_generation \
+	 ? (handle)->option : resolve_option_handle(handle))
+
+#define get_opt_bool_handle(handle)	get_opt_handle(handle)->value.number
+#define get_opt_int_handle(handle)	get_opt_handle(handle)->value.number
+#define get_opt_long_handle(handle)	get_opt_handle(handle)->value.big_number
+#define get_opt_str_handle(handle)	get_opt_handle(handle)->value.string
+#define get_opt_codepage_handle(handle)	get_opt_handle(handle)->value.number
+#define get_opt_color_handle(handle)	get_opt_handle(handle)->value.color
+
+long get_option_lookup_count(void);
+long get_option_crawl_count(void);
+
 extern struct option *add_opt(struct option *, char *, char *,
 			      char *, enum option_flags, enum option_type,
 			      long, long, longptr_T, char *);
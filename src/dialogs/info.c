@@ -232,15 +232,44 @@ get_resource_info(struct terminal *term, void *data)
 	val_add(n_("%ld refreshing", "%ld refreshing", val, term));
 	add_to_string(&info, ".\n");
 
-#ifdef CONFIG_ECMASCRIPT_SMJS
+#ifdef CONFIG_ECMASCRIPT
 	add_to_string(&info, _("ECMAScript", term));
 	add_to_string(&info, ": ");
 
 	val = ecmascript_get_interpreter_count();
 	val_add(n_("%ld interpreter", "%ld interpreters", val, term));
+	add_to_string(&info, ", ");
+
+	val = ecmascript_get_mutation_count();
+	val_add(n_("%ld mutation", "%ld mutations", val, term));
+	add_to_string(&info, ", ");
+
+	val = ecmascript_get_rerender_count();
+	val_add(n_("%ld rerendering", "%ld rerenderings", val, term));
+#ifdef CONFIG_QUICKJS
+	add_to_string(&info, ", ");
+
+	val = ecmascript_get_bytecode_hit_count();
+	val_add(n_("%ld compiled script reused", "%ld compiled scripts reused", val, term));
+	add_to_string(&info, ", ");
+
+	val = ecmascript_get_bytecode_miss_count();
+	val_add(n_("%ld script compiled", "%ld scripts compiled", val, term));
+#endif
 	add_to_string(&info, ".\n");
 #endif
 
+	add_to_string(&info, _("Options", term));
+	add_to_string(&info, ": ");
+
+	val = get_option_lookup_count();
+	val_add(n_("%ld lookup", "%ld lookups", val, term));
+	add_to_string(&info, ", ");
+
+	val = get_option_crawl_count();
+	val_add(n_("%ld tree crawl", "%ld tree crawls", val, term));
+	add_to_string(&info, ".\n");
+
 	add_to_string(&info, _("Interlinking", term));
 	add_to_string(&info, ": ");
 	if (term->master)
@@ -273,6 +302,29 @@ get_resource_info(struct terminal *term, void *data)
 		(double) (mem_stats.true_amount - mem_stats.amount) / (double) mem_stats.amount * 100);
 #endif /* DEBUG_MEMLEAK */
 
+#ifdef CONFIG_MEMPOOL
+	add_char_to_string(&info, '\n');
+	add_to_string(&info, _("Memory pool", term));
+	add_to_string(&info, ": ");
+
+	val = mem_pool_stats.used;
+	val_add(n_("%ld byte in use", "%ld bytes in use", val, term));
+	add_to_string(&info, ", ");
+
+	val = mem_pool_stats.slabs;
+	val_add(n_("%ld byte in slabs", "%ld bytes in slabs", val, term));
+	add_to_string(&info, ", ");
+
+	val = mem_pool_stats.large;
+	val_add(n_("%ld byte in large blocks", "%ld bytes in large blocks", val, term));
+
+	if (mem_pool_stats.slabs)
+		add_format_to_string(&info, " (%0.2f%% fragmentation).",
+			(double) (mem_pool_stats.slabs - mem_pool_stats.used) / (double) mem_pool_stats.slabs * 100);
+	else
+		add_char_to_string(&info, '.');
+#endif /* CONFIG_MEMPOOL */
+
 #undef val_add
 
 	return info.source;
@@ -6,12 +6,15 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "elinks.h"
 
 #include "document/docdata.h"
 #include "document/document.h"
+#include "terminal/draw.h"
 #include "util/error.h"
+#include "util/string.h"
 
 
 struct line *
@@ -29,3 +32,123 @@ realloc_lines(struct document *document, int y)
 
 	return &document->data[y];
 }
+
+
+/* The lines of documents sitting unused in the format cache are packed as
+ * runs of cells sharing attributes and colors. Each run is stored as its
+ * length, the attribute byte and the color union, followed by the
+ * characters of its cells. Numbers are stored seven bits a byte, so most
+ * text takes a byte per cell instead of a whole struct screen_char. The
+ * length of each line stays in document->data. */
+
+static int
+add_packed_number(struct string *packed, unsigned int number)
+{
+	char bytes[5];
+	int length = 0;
+
+	for (; number >= 0x80; number >>= 7)
+		bytes[length++] = (number & 0x7F) | 0x80;
+	bytes[length++] = number;
+
+	return !!add_bytes_to_string(packed, bytes, length);
+}
+
+static unsigned int
+get_packed_number(unsigned char **pos)
+{
+	unsigned int number = 0;
+	int shift = 0;
+
+	for (; **pos & 0x80; shift += 7)
+		number |= (unsigned int) (*(*pos)++ & 0x7F) << shift;
+
+	return number | (unsigned int) *(*pos)++ << shift;
+}
+
+static int
+pack_line(struct string *packed, struct line *line)
+{
+	int x = 0;
+
+	while (x < line->length) {
+		struct screen_char *run = &line->chars[x];
+		int end = x + 1;
+
+		while (end < line->length
+		       && line->chars[end].attr == run->attr
+		       && !memcmp(&line->chars[end].c, &run->c, sizeof(run->c)))
+			end++;
+
+		if (!add_packed_number(packed, end - x)
+		    || !add_bytes_to_string(packed, (char *) &run->attr, 1)
+		    || !add_bytes_to_string(packed, (char *) &run->c,
+					    sizeof(run->c)))
+			return 0;
+
+		for (; x < end; x++)
+			if (!add_packed_number(packed, line->chars[x].data))
+				return 0;
+	}
+
+	return 1;
+}
+
+void
+compact_document_lines(struct document *document)
+{
+	struct string packed;
+	char *data;
+	int y;
+
+	if (document->packed_data || !document->data) return;
+	if (!init_string(&packed)) return;
+
+	for (y = 0; y < document->height; y++) {
+		if (!pack_line(&packed, &document->data[y])) {
+			done_string(&packed);
+			return;
+		}
+	}
+
+	for (y = 0; y < document->height; y++)
+		mem_free_set(&document->data[y].chars, NULL);
+
+	data = (char *)mem_realloc(packed.source, packed.length + 1);
+	document->packed_data = (unsigned char *) (data ? data : packed.source);
+}
+
+int
+expand_document_lines(struct document *document)
+{
+	unsigned char *pos = document->packed_data;
+	int y;
+
+	if (!pos) return 1;
+
+	for (y = 0; y < document->height; y++) {
+		struct line *line = &document->data[y];
+		int x = 0;
+
+		if (!line->length) continue;
+		if (!ALIGN_LINE(&line->chars, 0, line->length))
+			return 0;
+
+		while (x < line->length) {
+			struct screen_char template_;
+			int count = get_packed_number(&pos);
+
+			template_.attr = *pos++;
+			memcpy(&template_.c, pos, sizeof(template_.c));
+			pos += sizeof(template_.c);
+
+			for (; count > 0; count--, x++) {
+				copy_struct(&line->chars[x], &template_);
+				line->chars[x].data = get_packed_number(&pos);
+			}
+		}
+	}
+
+	mem_free_set(&document->packed_data, NULL);
+	return 1;
+}
@@ -21,6 +21,14 @@ extern "C" {
 
 struct line *realloc_lines(struct document *document, int y);
 
+/** Packs the lines of a document not in use to free their chars. */
+void compact_document_lines(struct document *document);
+
+/** Unpacks the lines packed by compact_document_lines().
+ * @return 0 if out of memory, in which case the document can only be
+ * freed. */
+int expand_document_lines(struct document *document);
+
 #ifdef __cplusplus
 }
 #endif
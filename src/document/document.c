@@ -51,6 +51,7 @@
 
 #include "cache/cache.h"
 #include "config/options.h"
+#include "document/docdata.h"
 #include "document/document.h"
 #include "document/forms.h"
 #include "document/html/frames.h"
@@ -59,6 +60,7 @@
 #include "document/html/parser/parse.h"
 #include "document/html/renderer.h"
 #include "document/options.h"
+#include "document/plain/renderer.h"
 #include "document/refresh.h"
 
 #ifdef CONFIG_ECMASCRIPT
@@ -275,6 +277,8 @@ reset_document(struct document *document)
 		mem_free_set(&document->data, NULL);
 		document->height = 0;
 	}
+	done_plain_index(document);
+	mem_free_set(&document->packed_data, NULL);
 
 	mem_free_set(&document->lines1, NULL);
 	mem_free_set(&document->lines2, NULL);
@@ -296,8 +300,9 @@ reset_document(struct document *document)
 ///	free_document(document->dom);
 #endif
 
-	free_list(document->tags);
-	free_list(document->nodes);
+	init_list(document->tags);
+	init_list(document->nodes);
+	done_arena(&document->arena);
 
 	mem_free_set(&document->search, NULL);
 	mem_free_set(&document->slines1, NULL);
@@ -346,6 +351,8 @@ done_document(struct document *document)
 
 		mem_free(document->data);
 	}
+	done_plain_index(document);
+	mem_free_set(&document->packed_data, NULL);
 
 	mem_free_if(document->lines1);
 	mem_free_if(document->lines2);
@@ -363,11 +370,13 @@ done_document(struct document *document)
 	free_uri_list(&document->ecmascript_imports);
 	kill_timer(&document->timeout);
 	mem_free_if(document->text);
+	invalidate_dom_index(document);
 	free_document(document->dom);
 #endif
 
-	free_list(document->tags);
-	free_list(document->nodes);
+	init_list(document->tags);
+	init_list(document->nodes);
+	done_arena(&document->arena);
 
 	mem_free_if(document->search);
 	mem_free_if(document->slines1);
@@ -472,6 +481,13 @@ get_cached_document(struct cache_entry *cached, struct document_options *options
 			continue;
 		}
 
+		if (!expand_document_lines(document)) {
+			if (!is_object_used(document)) {
+				done_document(document);
+			}
+			continue;
+		}
+
 		/* Reactivate */
 		move_to_top_of_list(format_cache, document);
 
@@ -521,6 +537,14 @@ shrink_format_cache(int whole)
 
 	assertm(format_cache_entries >= 0, "format_cache_entries underflow");
 	if_assert_failed format_cache_entries = 0;
+
+	if (whole || !get_opt_bool("document.cache.format.compact", NULL))
+		return;
+
+	foreach (document, format_cache) {
+		if (!is_object_used(document))
+			compact_document_lines(document);
+	}
 }
 
 int
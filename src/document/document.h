@@ -6,6 +6,7 @@
 #include "main/object.h"
 #include "main/timer.h"
 #include "protocol/uri.h"
+#include "util/arena.h"
 #include "util/color.h"
 #include "util/lists.h"
 #include "util/box.h"
@@ -20,6 +21,7 @@ struct el_form_control;
 struct frame_desc;
 struct frameset_desc;
 struct module;
+struct plain_index;
 struct screen_char;
 
 /** Nodes are used for marking areas of text on the document canvas as
@@ -195,6 +197,9 @@ struct document {
 	LIST_OF(struct form) forms;
 	LIST_OF(struct tag) tags;
 	LIST_OF(struct node) nodes;
+	/** Holds @c tags and @c nodes, which live exactly as long as the
+	 * rendered content and are released in one go. */
+	struct arena arena;
 
 #ifdef CONFIG_ECMASCRIPT
 	/** ECMAScript snippets to be executed during loading the document into
@@ -210,8 +215,14 @@ struct document {
 	struct uri_list ecmascript_imports;
 	/** used by setTimeout */
 	timer_id_T timeout;
+	/** Pending rerendering after DOM mutations by scripts. */
+	timer_id_T rerender_timer;
+	/** When the document was last rerendered after DOM mutations. */
+	timeval_T last_rerender;
 	int ecmascript_counter;
 	void *dom;
+	/** Lookup tables for #dom, see ecmascript/dom-index.h. */
+	void *dom_index;
 	char *text;
 #endif
 #ifdef CONFIG_CSS
@@ -241,6 +252,15 @@ struct document {
 
 	struct line *data;
 
+	/** Plain text documents bigger than document.plain.window_size
+	 * only have the lines around the viewed part laid out in #data.
+	 * @see render_plain_lines() */
+	struct plain_index *plain_index;
+
+	/** The chars of #data packed while the document sits unused in
+	 * the format cache. @see compact_document_lines() */
+	unsigned char *packed_data;
+
 	struct link *links;
 	/** @name Arrays with one item per rendered document's line.
 	 * @{ */
@@ -4,6 +4,7 @@
 
 #include "document/css/stylesheet.h"
 #include "document/html/parser.h"
+#include "util/arena.h"
 #include "util/lists.h"
 
 #ifdef __cplusplus
@@ -64,6 +65,10 @@ struct html_context {
 	 * html/parser/stack.c
 	 * html/parser.c */
 	LIST_OF(struct html_element) stack;
+	/* Elements popped off the stack, kept for reuse. Both lists are
+	 * allocated from @arena, which is freed with the context. */
+	LIST_OF(struct html_element) free_elements;
+	struct arena arena;
 
 	/* For parser/parse.c: */
 	char *eoff; /* For parser/forms.c too */
@@ -778,6 +778,7 @@ init_html_parser(struct uri *uri, struct document_options *options,
 #endif
 
 	init_list(html_context->stack);
+	init_list(html_context->free_elements);
 
 	html_context->startf = start;
 	html_context->put_chars_f = put_chars;
@@ -794,7 +795,7 @@ init_html_parser(struct uri *uri, struct document_options *options,
 	 * should use the document charset instead.  */
 	scan_http_equiv(start, end, head, title, options->cp);
 
-	e = mem_calloc(1, sizeof(*e));
+	e = arena_calloc(&html_context->arena, sizeof(*e));
 	if (!e) return NULL;
 	add_to_list(html_context->stack, e);
 
@@ -865,5 +866,6 @@ done_html_parser(struct html_context *html_context)
 		"html stack not empty after operation");
 	if_assert_failed init_list(html_context->stack);
 
+	done_arena(&html_context->arena);
 	mem_free(html_context);
 }
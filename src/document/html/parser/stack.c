@@ -135,7 +135,7 @@ kill_html_stack_item(struct html_context *html_context, struct html_element *e)
 	mem_free_if(e->attr.onblur);
 
 	del_from_list(e);
-	mem_free(e);
+	add_to_list(html_context->free_elements, e);
 #if 0
 	if (list_empty(html_context->stack)
 	    || !html_context->stack.next) {
@@ -154,8 +154,13 @@ html_stack_dup(struct html_context *html_context, enum html_element_mortality_ty
 	assertm(ep && (void *) ep != &html_context->stack, "html stack empty");
 	if_assert_failed return;
 
-	e = mem_alloc(sizeof(*e));
-	if (!e) return;
+	if (!list_empty(html_context->free_elements)) {
+		e = html_context->free_elements.next;
+		del_from_list(e);
+	} else {
+		e = arena_alloc(&html_context->arena, sizeof(*e));
+		if (!e) return;
+	}
 
 	copy_struct(e, ep);
 
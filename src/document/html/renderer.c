@@ -1537,7 +1537,7 @@ html_special_tag(struct document *document, char *t, int x, int y)
 
 	tag_len = strlen(t);
 	/* One byte is reserved for name in struct tag. */
-	tag = mem_alloc(sizeof(*tag) + tag_len);
+	tag = arena_alloc(&document->arena, sizeof(*tag) + tag_len);
 	if (!tag) return;
 
 	tag->x = x;
@@ -2444,7 +2444,7 @@ format_html_part(struct html_context *html_context,
 	if_assert_failed return NULL;
 
 	if (document) {
-		struct node *node = mem_alloc(sizeof(*node));
+		struct node *node = arena_alloc(&document->arena, sizeof(*node));
 
 		if (node) {
 			int node_width = !html_context->table_level ? INT_MAX : width;
@@ -62,6 +62,7 @@ struct document_options {
 	int meta_link_display;
 	int default_form_input_size;
 	int document_width;
+	int plain_window_size;
 
 	/** @name The default (fallback) colors.
 	 * @{ */
@@ -54,8 +54,20 @@ struct plain_renderer {
 
 	/* Are we doing line compression */
 	unsigned int compress:1;
+
+	/* Is the source UTF-8 */
+	unsigned int utf8:1;
+
+	/* What became of the previous line of the source */
+	unsigned int was_empty_line:1;
+	unsigned int was_wrapped:1;
 };
 
+/* Documents laid out in windows keep this many lines around the ones asked
+ * for by render_plain_lines(), so that scrolling does not redo it at each
+ * step. */
+#define PLAIN_WINDOW_MARGIN	256
+
 #define realloc_document_links(doc, size) \
 	ALIGN_LINK(&(doc)->links, (doc)->nlinks, size)
 
@@ -717,7 +729,7 @@ init_template(struct screen_char *template_, struct document_options *options)
 static struct node *
 add_node(struct plain_renderer *renderer, int x, int width, int height)
 {
-	struct node *node = mem_alloc(sizeof(*node));
+	struct node *node = arena_alloc(&renderer->document->arena, sizeof(*node));
 
 	if (node) {
 		struct document *document = renderer->document;
@@ -733,128 +745,219 @@ add_node(struct plain_renderer *renderer, int x, int width, int height)
 	return node;
 }
 
-static void
-add_document_lines(struct plain_renderer *renderer)
+/* Where the next line of the source goes: @skip bytes are dropped, @width
+ * bytes are shown and the line after it starts @step bytes later. */
+struct plain_line {
+	int skip;
+	int width;
+	int step;
+
+	/* The screen cells it needs, not counting tabs and escapes right */
+	int cells;
+};
+
+/* Returns 0 if the source ends with an incomplete character, -1 if the line
+ * is left out and 1 if it is to be added. */
+static int
+layout_document_line(struct plain_renderer *renderer, char *source,
+		     int length, struct plain_line *line)
 {
-	char *source = renderer->source;
-	int length = renderer->length;
-	int was_empty_line = 0;
-	int was_wrapped = 0;
-#ifdef CONFIG_UTF8
-	int utf8 = is_cp_utf8(renderer->document->cp);
-#endif
-	for (; length > 0; renderer->lineno++) {
-		char *xsource;
-		int width, added, only_spaces = 1, spaces = 0, was_spaces = 0;
-		int last_space = 0;
-		int tab_spaces = 0;
-		int step = 0;
- 		int cells = 0;
-
-		/* End of line detection: We handle \r, \r\n and \n types. */
- 		for (width = 0; (width < length) &&
- 				(cells < renderer->max_width);) {
-			if (source[width] == ASCII_CR)
-				step++;
-			if (source[width + step] == ASCII_LF)
-				step++;
-			if (step) break;
-
-			if (isspace(source[width])) {
-				last_space = width;
-				if (only_spaces)
-					spaces++;
-				else
-					was_spaces++;
-				if (source[width] == '\t')
-					tab_spaces += 7 - ((width + tab_spaces) % 8);
-			} else {
-				only_spaces = 0;
-				was_spaces = 0;
-			}
+	int width, only_spaces = 1, spaces = 0, was_spaces = 0;
+	int last_space = 0;
+	int tab_spaces = 0;
+	int step = 0;
+	int cells = 0;
+
+	/* End of line detection: We handle \r, \r\n and \n types. */
+	for (width = 0; (width < length) &&
+			(cells < renderer->max_width);) {
+		if (source[width] == ASCII_CR)
+			step++;
+		if (source[width + step] == ASCII_LF)
+			step++;
+		if (step) break;
+
+		if (isspace(source[width])) {
+			last_space = width;
+			if (only_spaces)
+				spaces++;
+			else
+				was_spaces++;
+			if (source[width] == '\t')
+				tab_spaces += 7 - ((width + tab_spaces) % 8);
+		} else {
+			only_spaces = 0;
+			was_spaces = 0;
+		}
 #ifdef CONFIG_UTF8
-			if (utf8) {
-				char *text = &source[width];
-				unicode_val_T data = utf8_to_unicode(&text,
-							&source[length]);
+		if (renderer->utf8) {
+			char *text = &source[width];
+			unicode_val_T data = utf8_to_unicode(&text,
+						&source[length]);
 
-				if (data == UCS_NO_CHAR) return;
+			if (data == UCS_NO_CHAR) return 0;
 
-				cells += unicode_to_cell(data);
-				width += utf8charlen(&source[width]);
-			} else
+			cells += unicode_to_cell(data);
+			width += utf8charlen(&source[width]);
+		} else
 #endif /* CONFIG_UTF8 */
-			{
-				cells++;
-				width++;
-			}
+		{
+			cells++;
+			width++;
 		}
+	}
 
-		if (only_spaces && step) {
-			if (was_wrapped || (renderer->compress && was_empty_line)) {
-				/* Successive empty lines will appear as one. */
-				length -= step + spaces;
-				source += step + spaces;
-				renderer->lineno--;
-				assert(renderer->lineno >= 0);
-				continue;
-			}
-			was_empty_line = 1;
+	line->cells = cells + tab_spaces;
 
-			/* No need to keep whitespaces on an empty line. */
-			source += spaces;
-			length -= spaces;
-			width -= spaces;
+	if (only_spaces && step) {
+		/* No need to keep whitespaces on an empty line. */
+		line->skip = spaces;
+		line->width = 0;
+		line->step = step;
 
-		} else {
-			was_empty_line = 0;
-			was_wrapped = !step;
+		if (renderer->was_wrapped
+		    || (renderer->compress && renderer->was_empty_line)) {
+			/* Successive empty lines will appear as one. */
+			return -1;
+		}
+		renderer->was_empty_line = 1;
+		return 1;
+	}
 
-			if (was_spaces && step) {
-				/* Drop trailing whitespaces. */
-				width -= was_spaces;
-				step += was_spaces;
-			}
+	renderer->was_empty_line = 0;
+	renderer->was_wrapped = !step;
 
-			if (!step && (width < length) && last_space) {
-				width = last_space;
-				step = 1;
-			}
-		}
+	if (was_spaces && step) {
+		/* Drop trailing whitespaces. */
+		width -= was_spaces;
+		step += was_spaces;
+	}
 
-		assert(width >= 0);
+	if (!step && (width < length) && last_space) {
+		width = last_space;
+		step = 1;
+	}
 
-		/* We will touch the supplied source, so better replicate it. */
-		xsource = memacpy(source, width);
-		if (!xsource) continue;
+	assert(width >= 0);
 
-		added = add_document_line(renderer, xsource, width);
-		mem_free(xsource);
+	line->skip = 0;
+	line->width = width;
+	line->step = step;
+	return 1;
+}
 
+/* Lays out @width bytes of @source on the line renderer->lineno. */
+static int
+add_layout_line(struct plain_renderer *renderer, char *source, int width)
+{
+	/* We will touch the supplied source, so better replicate it. */
+	char *xsource = memacpy(source, width);
+	int added;
+
+	if (!xsource) return 0;
+
+	added = add_document_line(renderer, xsource, width);
+	mem_free(xsource);
+
+	return added;
+}
+
+static void
+add_document_lines(struct plain_renderer *renderer)
+{
+	char *source = renderer->source;
+	int length = renderer->length;
+
+	for (; length > 0; renderer->lineno++) {
+		struct plain_line line;
+		int added = layout_document_line(renderer, source, length, &line);
+
+		if (!added) return;
+
+		source += line.skip;
+		length -= line.skip;
+
+		if (added < 0) {
+			length -= line.step;
+			source += line.step;
+			renderer->lineno--;
+			assert(renderer->lineno >= 0);
+			continue;
+		}
+
+		added = add_layout_line(renderer, source, line.width);
 		if (added) {
 			/* Add (search) nodes on a line by line basis */
 			add_node(renderer, 0, added, 1);
 		}
 
 		/* Skip end of line chars too. */
-		width += step;
-		length -= width;
-		source += width;
+		length -= line.width + line.step;
+		source += line.width + line.step;
 	}
 
 	assert(!length);
 }
 
+/* Instead of laying out the lines, only notes where each of them starts in
+ * the source. */
+static void
+index_document_lines(struct plain_renderer *renderer)
+{
+	struct document *document = renderer->document;
+	struct plain_index *index = document->plain_index;
+	char *source = renderer->source;
+	int length = renderer->length;
+	int width = 0;
+
+	for (; length > 0; renderer->lineno++) {
+		struct plain_line line;
+		int added = layout_document_line(renderer, source, length, &line);
+
+		if (!added) break;
+
+		if (added > 0) {
+			if (renderer->lineno + 1 >= index->size) {
+				int size = index->size ? index->size * 2 : 1024;
+				int *offsets = mem_realloc(index->offsets,
+							   size * sizeof(*offsets));
+
+				if (!offsets) break;
+				index->offsets = offsets;
+				index->size = size;
+			}
+			index->offsets[renderer->lineno] = source - renderer->source;
+			int_lower_bound(&width, line.cells);
+		} else {
+			renderer->lineno--;
+		}
+
+		length -= line.skip + line.width + line.step;
+		source += line.skip + line.width + line.step;
+	}
+
+	if (!renderer->lineno || !realloc_lines(document, renderer->lineno - 1))
+		return;
+
+	index->offsets[renderer->lineno] = source - renderer->source;
+	index->from = index->to = 0;
+
+	/* One node for the whole text lets the search find all of it. */
+	renderer->lineno = 0;
+	add_node(renderer, 0, width, document->height);
+}
+
+/* Turns ascii borders on the lines from @from to @to - 1 into frames. */
 static void
-fixup_tables(struct plain_renderer *renderer)
+fixup_tables(struct plain_renderer *renderer, int from, int to)
 {
 	int y;
 
-	for (y = 0; y < renderer->lineno; y++) {
+	for (y = from; y < to; y++) {
 		int x;
-		struct line *prev_line = y > 0 ? &renderer->document->data[y - 1] : NULL;
+		struct line *prev_line = y > from ? &renderer->document->data[y - 1] : NULL;
 		struct line *line = &renderer->document->data[y];
-		struct line *next_line = y < renderer->lineno - 1 ? &renderer->document->data[y + 1] : NULL;
+		struct line *next_line = y < to - 1 ? &renderer->document->data[y + 1] : NULL;
 
 		for (x = 0; x < line->length; x++) {
 			int dir;
@@ -952,29 +1055,67 @@ fixup_tables(struct plain_renderer *renderer)
 	}
 }
 
+static void
+init_plain_renderer(struct plain_renderer *renderer,
+		    struct cache_entry *cached, struct document *document,
+		    char *source, int length)
+{
+	char *head = empty_string_or_(cached->head);
+
+	renderer->convert_table = get_convert_table(head, document->options.cp,
+						    document->options.assume_cp,
+						    &document->cp,
+						    &document->cp_status,
+						    document->options.hard_assume);
+
+	renderer->source = source;
+	renderer->length = length;
+
+	renderer->document = document;
+	renderer->lineno = 0;
+	renderer->compress = document->options.plain_compress_empty_lines;
+	renderer->max_width = document->options.wrap ? document->options.document_width
+						     : INT_MAX;
+	renderer->was_empty_line = 0;
+	renderer->was_wrapped = 0;
+#ifdef CONFIG_UTF8
+	renderer->utf8 = is_cp_utf8(document->cp);
+#else
+	renderer->utf8 = 0;
+#endif
+
+	/* Setup the style */
+	init_template(&renderer->template_, &document->options);
+}
+
+/* Whether @buffer is big enough to be laid out only around what is being
+ * viewed. Its lines are then found again in the cache entry later, which
+ * is not possible if the source had to be decoded. Links are not detected
+ * either, since they have to be known all at once. */
+static int
+use_plain_window(struct cache_entry *cached, struct document *document,
+		 struct string *buffer)
+{
+	struct fragment *fragment;
+	int size = document->options.plain_window_size;
+
+	if (!size || document->options.dump
+	    || document->options.plain_display_links
+	    || buffer->length / 1024 < size)
+		return 0;
+
+	fragment = get_cache_fragment(cached);
+	return fragment && fragment->data == buffer->source;
+}
+
 void
 render_plain_document(struct cache_entry *cached, struct document *document,
 		      struct string *buffer)
 {
-	struct conv_table *convert_table;
-	char *head = empty_string_or_(cached->head);
 	struct plain_renderer renderer;
 
-	convert_table = get_convert_table(head, document->options.cp,
-					  document->options.assume_cp,
-					  &document->cp,
-					  &document->cp_status,
-					  document->options.hard_assume);
-
-	renderer.source = buffer->source;
-	renderer.length = buffer->length;
-
-	renderer.document = document;
-	renderer.lineno = 0;
-	renderer.convert_table = convert_table;
-	renderer.compress = document->options.plain_compress_empty_lines;
-	renderer.max_width = document->options.wrap ? document->options.document_width
-						    : INT_MAX;
+	init_plain_renderer(&renderer, cached, document,
+			    buffer->source, buffer->length);
 
 	document->color.background = document->options.default_style.color.background;
 	document->width = 0;
@@ -982,12 +1123,145 @@ render_plain_document(struct cache_entry *cached, struct document *document,
 	document->options.utf8 = is_cp_utf8(document->options.cp);
 #endif /* CONFIG_UTF8 */
 
-	/* Setup the style */
-	init_template(&renderer.template_, &document->options);
+	if (use_plain_window(cached, document, buffer)) {
+		document->plain_index = mem_calloc(1, sizeof(*document->plain_index));
+		if (document->plain_index) {
+			index_document_lines(&renderer);
+			return;
+		}
+	}
 
 	add_document_lines(&renderer);
 
 	if (document->options.plain_fixup_tables) {
-		fixup_tables(&renderer);
+		fixup_tables(&renderer, 0, renderer.lineno);
 	}
 }
+
+void
+render_plain_lines(struct document *document, int from, int to)
+{
+	struct plain_index *index = document->plain_index;
+	struct plain_renderer renderer;
+	struct screen_char template_;
+	struct fragment *fragment;
+	int y;
+
+	if (!index || !index->offsets) return;
+
+	int_bounds(&from, 0, document->height);
+	int_bounds(&to, from, document->height);
+	if (from >= index->from && to <= index->to) return;
+
+	/* The source is only there as long as the cache entry is unchanged. */
+	fragment = get_cache_fragment(document->cached);
+	if (!fragment || document->cache_id != document->cached->cache_id
+	    || fragment->length < index->offsets[document->height])
+		return;
+
+	from = int_max(from - PLAIN_WINDOW_MARGIN, 0);
+	to = int_min(to + PLAIN_WINDOW_MARGIN, document->height);
+
+	/* The search data only covers the lines laid out so far. */
+	mem_free_set(&document->search, NULL);
+	mem_free_set(&document->slines1, NULL);
+	mem_free_set(&document->slines2, NULL);
+	document->nsearch = 0;
+
+	/* Let go of the lines that moved out of the window. */
+	for (y = index->from; y < index->to; y++) {
+		if (y >= from && y < to) continue;
+
+		mem_free_set(&document->data[y].chars, NULL);
+		document->data[y].length = 0;
+	}
+
+	init_plain_renderer(&renderer, document->cached, document,
+			    fragment->data, fragment->length);
+	template_ = renderer.template_;
+
+	for (y = from; y < to; y++) {
+		int offset = index->offsets[y];
+		struct plain_line line;
+		int added;
+
+		if (y >= index->from && y < index->to) continue;
+
+		/* Escape sequences only color the rest of their line here. */
+		renderer.template_ = template_;
+		renderer.lineno = y;
+
+		if (layout_document_line(&renderer, fragment->data + offset,
+					 fragment->length - offset, &line) <= 0)
+			continue;
+
+		added = add_layout_line(&renderer,
+					fragment->data + offset + line.skip,
+					line.width);
+		int_lower_bound(&document->width, added);
+	}
+
+	index->from = from;
+	index->to = to;
+
+	if (document->options.plain_fixup_tables) {
+		fixup_tables(&renderer, from, to);
+	}
+}
+
+int
+find_plain_line(struct document *document, int y, int direction,
+		int (*match)(void *data, int y, char *text, int length),
+		void *data)
+{
+	struct plain_index *index = document->plain_index;
+	struct plain_renderer renderer;
+	struct fragment *fragment;
+
+	if (!index || !index->offsets) return -1;
+
+	fragment = get_cache_fragment(document->cached);
+	if (!fragment || document->cache_id != document->cached->cache_id
+	    || fragment->length < index->offsets[document->height])
+		return -1;
+
+	init_plain_renderer(&renderer, document->cached, document,
+			    fragment->data, fragment->length);
+
+	for (; y >= 0 && y < document->height; y += direction) {
+		int offset = index->offsets[y];
+		struct plain_line line;
+		char *text;
+		int length, found;
+
+		/* Each line is looked at on its own, in any order. */
+		renderer.was_empty_line = 0;
+		renderer.was_wrapped = 0;
+
+		if (layout_document_line(&renderer, fragment->data + offset,
+					 fragment->length - offset, &line) <= 0
+		    || !line.width)
+			continue;
+
+		text = convert_string(renderer.convert_table,
+				      fragment->data + offset + line.skip,
+				      line.width, document->options.cp,
+				      CSM_NONE, &length, NULL, NULL);
+		if (!text) return -1;
+
+		found = match(data, y, text, length);
+		mem_free(text);
+		if (found) return y;
+	}
+
+	return -1;
+}
+
+void
+done_plain_index(struct document *document)
+{
+	if (!document->plain_index) return;
+
+	mem_free_if(document->plain_index->offsets);
+	mem_free_set(&document->plain_index, NULL);
+}
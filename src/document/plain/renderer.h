@@ -10,8 +10,33 @@ struct cache_entry;
 struct document;
 struct string;
 
+/* Where the lines of a plain text document laid out in windows start. */
+struct plain_index {
+	/* Line y starts at offsets[y] in the source, which ends at
+	 * offsets[height]. */
+	int *offsets;
+	int size;
+
+	/* The lines from @from to @to - 1 are laid out. */
+	int from, to;
+};
+
 void render_plain_document(struct cache_entry *cached, struct document *document, struct string *buffer);
 
+/* Makes sure the lines from @from to @to - 1 of @document are laid out if
+ * it is a plain text document with a struct plain_index. Lines far from
+ * them may be let go of. */
+void render_plain_lines(struct document *document, int from, int to);
+
+/* Calls @match with the text of the lines of @document from @y on in
+ * @direction, converted as it is shown but not laid out, until it returns
+ * nonzero. Returns that line or -1 if there is none. */
+int find_plain_line(struct document *document, int y, int direction,
+		    int (*match)(void *data, int y, char *text, int length),
+		    void *data);
+
+void done_plain_index(struct document *document);
+
 #ifdef __cplusplus
 }
 #endif
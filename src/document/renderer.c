@@ -208,7 +208,7 @@ process_snippets(struct ecmascript_interpreter *interpreter,
 		if (fragment) {
 			struct string code = INIT_STRING(fragment->data, fragment->length);
 
-			ecmascript_eval(interpreter, &code, NULL);
+			ecmascript_eval_cached(interpreter, &code, cached);
 		}
 	}
 	check_for_rerender(interpreter, "eval");
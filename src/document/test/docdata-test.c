@@ -0,0 +1,211 @@
+/* Test compact_document_lines() and expand_document_lines() */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elinks.h"
+
+#include "document/docdata.h"
+#include "document/document.h"
+#include "terminal/draw.h"
+#include "util/memory.h"
+#include "util/test.h"
+
+#define TEST_LINES	9
+
+static void
+set_cell(struct screen_char *cell, unicode_val_T data, unsigned char attr,
+	 unsigned char color)
+{
+	int i;
+
+	memset(cell, 0, sizeof(*cell));
+	cell->data = data;
+	cell->attr = attr;
+	for (i = 0; i < SCREEN_COLOR_SIZE; i++)
+		cell->c.color[i] = color + i;
+}
+
+static struct screen_char *
+add_test_line(struct document *document, int y, int length)
+{
+	struct line *line = &document->data[y];
+
+	line->length = length;
+	line->chars = length ? mem_calloc(length, sizeof(*line->chars)) : NULL;
+	if (length && !line->chars)
+		die("out of memory");
+
+	return line->chars;
+}
+
+static void
+fill_test_document(struct document *document)
+{
+	static const unicode_val_T code_points[] = {
+		'a', 0x7F, 0x80, 0xE9, 0xFF,
+#ifdef CONFIG_UTF8
+		0x100, 0x3FFF, 0x4000, 0xFFFD, 0x1F600, 0x10FFFF,
+#endif
+	};
+	struct screen_char *chars;
+	int x;
+
+	document->height = TEST_LINES;
+	document->data = mem_calloc(TEST_LINES, sizeof(*document->data));
+	if (!document->data)
+		die("out of memory");
+
+	/* Runs of plain, bold and underlined text in different colors. */
+	chars = add_test_line(document, 0, 9);
+	for (x = 0; x < 5; x++)
+		set_cell(&chars[x], "Hello"[x], 0, 0x07);
+	for (; x < 8; x++)
+		set_cell(&chars[x], 'b', SCREEN_ATTR_BOLD, 0x1E);
+	set_cell(&chars[x], 'u', SCREEN_ATTR_UNDERLINE, 0x1E);
+
+	/* Line 1 stays empty. */
+
+	/* The attributes or colors change at each cell. */
+	chars = add_test_line(document, 2, 20);
+	for (x = 0; x < 20; x++)
+		set_cell(&chars[x], 'A' + x, x % 3 ? SCREEN_ATTR_ITALIC : 0,
+			 x % 2 ? 0x42 : 0x24);
+
+	/* Characters needing one to three bytes in a run of their own. */
+	chars = add_test_line(document, 3, sizeof_array(code_points));
+	for (x = 0; x < sizeof_array(code_points); x++)
+		set_cell(&chars[x], code_points[x], 0, 0x70);
+
+	/* A run longer than fits the one byte count. */
+	chars = add_test_line(document, 4, 300);
+	for (x = 0; x < 300; x++)
+		set_cell(&chars[x], code_points[x % sizeof_array(code_points)],
+			 SCREEN_ATTR_STANDOUT, 0x13);
+
+	/* Line 5 stays empty. */
+
+	chars = add_test_line(document, 6, 3);
+	set_cell(&chars[0], BORDER_SULCORNER, SCREEN_ATTR_FRAME, 0x01);
+	set_cell(&chars[1], BORDER_SHLINE, SCREEN_ATTR_FRAME, 0x01);
+	set_cell(&chars[2], BORDER_SURCORNER, SCREEN_ATTR_FRAME, 0x01);
+
+	/* A single cell between empty lines, the last one included. */
+	chars = add_test_line(document, 7, 1);
+	set_cell(&chars[0], ' ', 0, 0x00);
+}
+
+static struct line *
+copy_test_lines(struct document *document)
+{
+	struct line *lines = mem_calloc(document->height, sizeof(*lines));
+	int y;
+
+	if (!lines)
+		die("out of memory");
+
+	for (y = 0; y < document->height; y++) {
+		struct line *line = &document->data[y];
+
+		lines[y].length = line->length;
+		if (!line->length) continue;
+
+		lines[y].chars = mem_alloc(line->length * sizeof(*line->chars));
+		if (!lines[y].chars)
+			die("out of memory");
+		copy_screen_chars(lines[y].chars, line->chars, line->length);
+	}
+
+	return lines;
+}
+
+static void
+check_test_lines(struct document *document, struct line *lines, int round)
+{
+	int y;
+
+	for (y = 0; y < document->height; y++) {
+		struct line *line = &document->data[y];
+		int x;
+
+		if (line->length != lines[y].length)
+			die("round %d: line %d has length %d instead of %d",
+			    round, y, line->length, lines[y].length);
+
+		if (!line->length) {
+			if (line->chars)
+				die("round %d: empty line %d got chars",
+				    round, y);
+			continue;
+		}
+
+		for (x = 0; x < line->length; x++) {
+			struct screen_char *got = &line->chars[x];
+			struct screen_char *want = &lines[y].chars[x];
+
+			if (got->data != want->data
+			    || got->attr != want->attr
+			    || memcmp(got->c.color, want->c.color,
+				      sizeof(want->c.color)))
+				die("round %d: line %d cell %d is "
+				    "%#lx/%#x/%#x instead of %#lx/%#x/%#x",
+				    round, y, x,
+				    (unsigned long) got->data, got->attr,
+				    got->c.color[0],
+				    (unsigned long) want->data, want->attr,
+				    want->c.color[0]);
+		}
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	struct document document;
+	struct line *lines;
+	int round, y;
+
+	memset(&document, 0, sizeof(document));
+	fill_test_document(&document);
+	lines = copy_test_lines(&document);
+
+	/* Expanding lines which were never packed changes nothing. */
+	if (!expand_document_lines(&document))
+		die("expanding unpacked lines failed");
+	check_test_lines(&document, lines, 0);
+
+	for (round = 1; round <= 2; round++) {
+		compact_document_lines(&document);
+
+		if (!document.packed_data)
+			die("round %d: lines were not packed", round);
+
+		for (y = 0; y < document.height; y++)
+			if (document.data[y].chars)
+				die("round %d: line %d kept its chars",
+				    round, y);
+
+		if (!expand_document_lines(&document))
+			die("round %d: expanding lines failed", round);
+
+		if (document.packed_data)
+			die("round %d: packed lines were kept", round);
+
+		check_test_lines(&document, lines, round);
+	}
+
+	for (y = 0; y < document.height; y++) {
+		mem_free_if(document.data[y].chars);
+		mem_free_if(lines[y].chars);
+	}
+	mem_free(document.data);
+	mem_free(lines);
+
+	return 0;
+}
@@ -37,6 +37,7 @@
 #include "util/memory.h"
 #include "util/string.h"
 
+#include <libxml/xmlsave.h>
 #include <libxml++/libxml++.h>
 
 #if 0
@@ -267,6 +268,38 @@ dump_dom_structure(struct source_renderer *renderer, void *nod, int depth)
 }
 #endif
 
+static int
+write_to_elinks_string(void *context, const char *data, int length)
+{
+	struct string *buffer = (struct string *)context;
+
+	if (!add_bytes_to_string(buffer, data, length)) return -1;
+
+	return length;
+}
+
+/* Serialize the DOM tree of the document straight into @buffer. This avoids
+ * the intermediate copies made by xmlpp::Document::write_to_string_formatted().
+ * Returns non-zero on success. */
+int
+dump_xhtml_document(struct document *document, struct string *buffer)
+{
+	xmlpp::Document *doc = document->dom;
+	xmlSaveCtxtPtr ctxt;
+	long ret;
+
+	if (!doc) return 0;
+
+	ctxt = xmlSaveToIO(write_to_elinks_string, NULL, buffer, NULL,
+			   XML_SAVE_FORMAT | XML_SAVE_AS_XML);
+	if (!ctxt) return 0;
+
+	ret = xmlSaveDoc(ctxt, doc->cobj());
+	xmlSaveClose(ctxt);
+
+	return ret >= 0;
+}
+
 void
 render_xhtml_document(struct cache_entry *cached, struct document *document, struct string *buffer)
 {
@@ -302,17 +335,18 @@ render_xhtml_document(struct cache_entry *cached, struct document *document, str
 		if (cached->head) add_to_string(&head, cached->head);
 	}
 
-	xmlpp::Document *doc = document->dom;
-
+	/* TODO: Walk the DOM straight into the element handlers instead of
+	 * serializing it and parsing the text again, and lay out only the
+	 * changed subtree. The handlers still read the attributes from the
+	 * source text, so that has to be reworked first. */
 	if (!buffer) {
-		xmlpp::ustring text = doc->write_to_string_formatted();
 		struct string tt;
 
 		if (!init_string(&tt)) {
 			done_string(&head);
 			return;
 		}
-		add_bytes_to_string(&tt, text.c_str(), text.size());
+		dump_xhtml_document(document, &tt);
 		buffer = &tt;
 		document->text = tt.source;
 	}
@@ -9,6 +9,7 @@ struct cache_entry;
 struct document;
 struct string;
 
+int dump_xhtml_document(struct document *document, struct string *buffer);
 void render_xhtml_document(struct cache_entry *cached, struct document *document, struct string *buffer);
 
 
@@ -14,6 +14,10 @@
 #include <iostream>
 #include <string>
 #include <regex>
+#include <list>
+#include <unordered_map>
+
+#include <libxml/xpath.h>
 
 #include "ecmascript/css2xpath.h"
 
@@ -118,6 +122,12 @@ preg_replace(std::string & pattern, const char *replacement, std::string & subje
 	return subject;
 }
 
+std::string
+preg_replace(const std::regex &re, const char *replacement, std::string & subject)
+{
+	return std::regex_replace(subject, re, replacement);
+}
+
 using namespace std;
 
 typedef std::string (*my_callback_t)(const std::smatch &m);
@@ -128,6 +138,12 @@ preg_replace_callback(std::string & pattern, my_callback_t callback, std::string
 	return std::regex_replace2(subject, std::regex(pattern), callback);
 }
 
+std::string
+preg_replace_callback(const std::regex &re, my_callback_t callback, std::string & subject)
+{
+	return std::regex_replace2(subject, re, callback);
+}
+
 std::string
 dollar_equal_rule_callback(const std::smatch &matches)
 {
@@ -159,19 +175,31 @@ class Rule
 	}
 };
 
+/* The pattern is compiled once, when the rule is built, instead of
+ * on every translation. */
 class RegexRule : public Rule
 {
 	private:
 		const char *pattern, *replacement;
+		std::regex re;
+		bool valid;
 	public:
-		RegexRule(const char *pat, const char *repl) : pattern(pat), replacement(repl)
+		RegexRule(const char *pat, const char *repl) : pattern(pat), replacement(repl), valid(false)
 		{
+			try {
+				re.assign(pattern);
+				valid = true;
+			} catch (const std::regex_error &e) {
+				std::cout << e.what() << " " << pattern << "\n";
+			}
 		}
 		std::string apply(std::string &selector)
 		{
-			std::string r(pattern);
+			if (!valid) {
+				return selector;
+			}
 
-			return preg_replace(r, replacement, selector);
+			return preg_replace(re, replacement, selector);
 		}
 };
 
@@ -213,9 +241,10 @@ class NthChildRule : public Rule
 
 	std::string apply(std::string & selector)
 	{
+		static const std::regex re("([a-zA-Z0-9_\\-*]+):nth-child\\(([^)]*)\\)");
+
 		currentNth = this;
-		std::string pat("([a-zA-Z0-9_\\-*]+):nth-child\\(([^)]*)\\)");
-		return preg_replace_callback(pat, nth_callback, selector);
+		return preg_replace_callback(re, nth_callback, selector);
 	}
 
 	std::string callback(const std::smatch &matches)
@@ -242,9 +271,9 @@ class NthChildRule : public Rule
 		}
 		else
 		{
-			std::string pat("^([\\d]*)n.*?([\\d]*)$");
+			static const std::regex re("^([\\d]*)n.*?([\\d]*)$");
 			std::string m = matches[2].str();
-			std::string b1 = preg_replace(pat, "$1+$2", m);
+			std::string b1 = preg_replace(re, "$1+$2", m);
 			auto b = explode('+', b1);
 			int bint = atoi(b[1].c_str());
 			res << matches[1] << "[(count(preceding-sibling::*)+1)>=" << bint << " and ((count(preceding-sibling::*)+1)-"
@@ -280,9 +309,9 @@ class DollarEqualRule : public Rule
 
 	std::string apply(std::string &selector)
 	{
-		std::string pattern("\\[([a-zA-Z0-9\\_\\-]+)\\$=([^\\]]+)\\]");
+		static const std::regex re("\\[([a-zA-Z0-9\\_\\-]+)\\$=([^\\]]+)\\]");
 
-		return preg_replace_callback(pattern, dollar_equal_rule_callback, selector);
+		return preg_replace_callback(re, dollar_equal_rule_callback, selector);
 	}
 };
 
@@ -296,7 +325,7 @@ class Translator
 				selector = r->apply(selector);
 			}
 
-			std::string quotes("\"\"");
+			static const std::regex quotes("\"\"");
 			selector = preg_replace(quotes, "\"", selector);
 
 			return selector == "/" ? "/" : ("//" + selector);
@@ -398,18 +427,19 @@ NotRule::NotRule(Translator *tt) : t(tt)
 std::string
 NotRule::apply(std::string &selector)
 {
+	static const std::regex re("([a-zA-Z0-9\\_\\-\\*]+):not\\(([^\\)]*)\\)");
+
 	currentNotRule = this;
-	std::string pat("([a-zA-Z0-9\\_\\-\\*]+):not\\(([^\\)]*)\\)");
-	return preg_replace_callback(pat, not_rule_callback, selector);
+	return preg_replace_callback(re, not_rule_callback, selector);
 }
 
 std::string
 NotRule::callback(const std::smatch &matches)
 {
 	std::string m(matches[2].str());
-	std::string pat("^[^\\[]+\\[([^\\]]*)\\].*$");
+	static const std::regex re("^[^\\[]+\\[([^\\]]*)\\].*$");
 	std::string ret(t->translate(m));
-	std::string subresult = preg_replace(pat, "$1", ret);
+	std::string subresult = preg_replace(re, "$1", ret);
 	return matches[1].str() + "[not(" + subresult + ")]";
 }
 
@@ -425,6 +455,103 @@ css2xpath(std::string &selector)
 	return translator->translate(selector);
 }
 
+/* Selectors used by scripts tend to repeat (the same querySelector()
+ * call in a loop or an event handler), so keep the last few translated
+ * and compiled XPath expressions around, most recently used first.
+ * Invalid selectors are cached too, as a NULL expression. */
+struct css_selector_cache_entry {
+	std::string selector;
+	xmlXPathCompExprPtr expr;
+};
+
+static std::list<struct css_selector_cache_entry> css_selector_cache;
+static std::unordered_map<std::string, std::list<struct css_selector_cache_entry>::iterator> css_selector_cache_index;
+
+static xmlXPathCompExprPtr
+get_css_selector_expr(const std::string &selector)
+{
+	auto found = css_selector_cache_index.find(selector);
+
+	if (found != css_selector_cache_index.end()) {
+		css_selector_cache.splice(css_selector_cache.begin(), css_selector_cache, found->second);
+		return found->second->expr;
+	}
+
+	std::string css(selector);
+	std::string xpath = css2xpath(css);
+	xmlXPathCompExprPtr expr = xmlXPathCompile((const xmlChar *)xpath.c_str());
+
+	if (css_selector_cache.size() >= CSS_SELECTOR_CACHE_SIZE) {
+		struct css_selector_cache_entry &last = css_selector_cache.back();
+
+		if (last.expr) {
+			xmlXPathFreeCompExpr(last.expr);
+		}
+		css_selector_cache_index.erase(last.selector);
+		css_selector_cache.pop_back();
+	}
+
+	css_selector_cache.push_front({selector, expr});
+	css_selector_cache_index[selector] = css_selector_cache.begin();
+
+	return expr;
+}
+
+xmlpp::Node::NodeSet
+css_find(xmlpp::Node *node, const std::string &selector)
+{
+	xmlXPathCompExprPtr expr = get_css_selector_expr(selector);
+
+	if (!expr) {
+		throw xmlpp::exception("Invalid selector: " + selector);
+	}
+
+	xmlNode *cnode = node->cobj();
+	xmlXPathContextPtr ctxt = xmlXPathNewContext(cnode->doc);
+
+	if (!ctxt) {
+		throw xmlpp::exception("Could not create XPath context");
+	}
+	ctxt->node = cnode;
+
+	xmlXPathObjectPtr result = xmlXPathCompiledEval(expr, ctxt);
+
+	if (!result) {
+		xmlXPathFreeContext(ctxt);
+		throw xmlpp::exception("Invalid XPath: " + selector);
+	}
+
+	if (result->type != XPATH_NODESET) {
+		xmlXPathFreeObject(result);
+		xmlXPathFreeContext(ctxt);
+		throw xmlpp::exception("Only nodeset result types are supported.");
+	}
+
+	xmlpp::Node::NodeSet nodes;
+	xmlNodeSetPtr nodeset = result->nodesetval;
+
+	if (nodeset && !xmlXPathNodeSetIsEmpty(nodeset)) {
+		const int count = xmlXPathNodeSetGetLength(nodeset);
+
+		nodes.reserve(count);
+
+		for (int i = 0; i < count; i++) {
+			xmlNode *item = xmlXPathNodeSetItem(nodeset, i);
+
+			if (!item || item->type == XML_NAMESPACE_DECL) {
+				continue;
+			}
+			xmlpp::Node::create_wrapper(item);
+			nodes.push_back(static_cast<xmlpp::Node *>(item->_private));
+		}
+	}
+
+	xmlXPathFreeObject(result);
+	xmlXPathFreeContext(ctxt);
+
+	return nodes;
+}
+
 #if 0
 
 std::string
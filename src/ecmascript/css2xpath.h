@@ -2,7 +2,16 @@
 #define EL__ECMASCRIPT_CSS2XPATH_H
 
 #include <string>
+#include <libxml++/libxml++.h>
+
+/* How many compiled selectors css_find() keeps around. */
+#define CSS_SELECTOR_CACHE_SIZE 64
 
 std::string css2xpath(std::string &selector);
 
+/* Returns the nodes under @node matching the CSS @selector. The translated
+ * and compiled XPath is cached per selector. Throws xmlpp::exception on
+ * invalid selectors, like xmlpp::Node::find(). */
+xmlpp::Node::NodeSet css_find(xmlpp::Node *node, const std::string &selector);
+
 #endif
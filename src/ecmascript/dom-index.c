@@ -0,0 +1,199 @@
+/* Id, tag name and class name indexes of the DOM tree. */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elinks.h"
+
+#include "document/document.h"
+#include "ecmascript/dom-index.h"
+#include "ecmascript/ecmascript.h"
+
+#include <libxml++/libxml++.h>
+
+struct dom_index {
+	/* The first element in document order with the given id. */
+	std::unordered_map<xmlpp::ustring, xmlpp::Element *> ids;
+	/* Elements in document order by lowercase tag name. */
+	std::unordered_map<xmlpp::ustring, xmlpp::Node::NodeSet> tag_names;
+	/* Elements in document order by each of their class names. */
+	std::unordered_map<xmlpp::ustring, xmlpp::Node::NodeSet> class_names;
+	/* All elements in document order. */
+	xmlpp::Node::NodeSet elements;
+};
+
+static std::vector<xmlpp::ustring>
+split_class_names(const xmlpp::ustring &value)
+{
+	std::vector<xmlpp::ustring> names;
+	std::istringstream stream(value);
+	xmlpp::ustring name;
+
+	while (stream >> name)
+		names.push_back(name);
+
+	return names;
+}
+
+static void
+add_to_dom_index(struct dom_index *index, xmlpp::Element *element)
+{
+	xmlpp::ustring id = element->get_attribute_value("id");
+
+	index->elements.push_back(element);
+	index->tag_names[element->get_name()].push_back(element);
+
+	if (!id.empty())
+		index->ids.emplace(id, element);
+
+	for (auto &name : split_class_names(element->get_attribute_value("class"))) {
+		xmlpp::Node::NodeSet &elements = index->class_names[name];
+
+		/* Ignore class names repeated in the same attribute. */
+		if (elements.empty() || elements.back() != element)
+			elements.push_back(element);
+	}
+}
+
+static struct dom_index *
+get_dom_index(struct document *document)
+{
+	if (document->dom_index)
+		return (struct dom_index *)document->dom_index;
+
+	if (!document->dom) {
+		document->dom = document_parse(document);
+	}
+
+	if (!document->dom) {
+		return NULL;
+	}
+
+	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
+	xmlpp::Element *root = docu->get_root_node();
+	struct dom_index *index = new struct dom_index;
+
+	document->dom_index = index;
+
+	if (!root) {
+		return index;
+	}
+
+	/* Walk the tree in document order without recursing so that deeply
+	 * nested documents cannot exhaust the stack. */
+	std::vector<xmlpp::Element *> stack;
+
+	stack.push_back(root);
+
+	while (!stack.empty()) {
+		xmlpp::Element *element = stack.back();
+
+		stack.pop_back();
+		add_to_dom_index(index, element);
+
+		auto children = element->get_children();
+
+		for (auto it = children.rbegin(); it != children.rend(); ++it) {
+			xmlpp::Element *child = dynamic_cast<xmlpp::Element *>(*it);
+
+			if (child)
+				stack.push_back(child);
+		}
+	}
+
+	return index;
+}
+
+xmlpp::Element *
+get_dom_index_element_by_id(struct document *document, const xmlpp::ustring &id)
+{
+	struct dom_index *index = get_dom_index(document);
+
+	if (!index) return NULL;
+
+	auto found = index->ids.find(id);
+
+	return found != index->ids.end() ? found->second : NULL;
+}
+
+xmlpp::Node::NodeSet *
+get_dom_index_elements_by_tag_name(struct document *document, const xmlpp::ustring &tag_name)
+{
+	struct dom_index *index = get_dom_index(document);
+
+	if (!index) return NULL;
+
+	if (tag_name == "*") {
+		return new xmlpp::Node::NodeSet(index->elements);
+	}
+
+	xmlpp::ustring name = tag_name;
+
+	std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+	auto found = index->tag_names.find(name);
+
+	if (found == index->tag_names.end()) {
+		return new xmlpp::Node::NodeSet;
+	}
+
+	return new xmlpp::Node::NodeSet(found->second);
+}
+
+xmlpp::Node::NodeSet *
+get_dom_index_elements_by_class_name(struct document *document, const xmlpp::ustring &class_names)
+{
+	struct dom_index *index = get_dom_index(document);
+
+	if (!index) return NULL;
+
+	std::vector<xmlpp::ustring> names = split_class_names(class_names);
+	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
+
+	if (names.empty()) {
+		return elements;
+	}
+
+	auto found = index->class_names.find(names[0]);
+
+	if (found == index->class_names.end()) {
+		return elements;
+	}
+
+	/* Elements must have all the given class names. Start with the ones
+	 * having the first and filter out the rest. */
+	for (auto node : found->second) {
+		xmlpp::Element *element = static_cast<xmlpp::Element *>(node);
+		std::vector<xmlpp::ustring> element_names;
+		bool matches = true;
+
+		if (names.size() > 1)
+			element_names = split_class_names(element->get_attribute_value("class"));
+
+		for (size_t i = 1; i < names.size() && matches; i++) {
+			matches = std::find(element_names.begin(), element_names.end(), names[i]) != element_names.end();
+		}
+
+		if (matches)
+			elements->push_back(element);
+	}
+
+	return elements;
+}
+
+void
+invalidate_dom_index(struct document *document)
+{
+	if (!document || !document->dom_index)
+		return;
+
+	delete (struct dom_index *)document->dom_index;
+	document->dom_index = NULL;
+}
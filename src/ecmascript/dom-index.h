@@ -0,0 +1,16 @@
+#ifndef EL__ECMASCRIPT_DOM_INDEX_H
+#define EL__ECMASCRIPT_DOM_INDEX_H
+
+#include <libxml++/libxml++.h>
+
+struct document;
+
+/* Lookup tables for the DOM tree of a document shared by the ECMAScript
+ * backends. The tables are built on first use and dropped whenever a script
+ * adds or removes nodes or sets an id or class attribute. */
+
+xmlpp::Element *get_dom_index_element_by_id(struct document *document, const xmlpp::ustring &id);
+xmlpp::Node::NodeSet *get_dom_index_elements_by_tag_name(struct document *document, const xmlpp::ustring &tag_name);
+xmlpp::Node::NodeSet *get_dom_index_elements_by_class_name(struct document *document, const xmlpp::ustring &class_names);
+
+#endif
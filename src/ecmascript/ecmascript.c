@@ -6,6 +6,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "elinks.h"
 
@@ -18,6 +19,7 @@
 #include "document/xml/renderer.h"
 #include "document/xml/renderer2.h"
 #include "ecmascript/ecmascript.h"
+#include "ecmascript/localstorage-db.h"
 #ifdef CONFIG_QUICKJS
 #include "ecmascript/quickjs.h"
 #else
@@ -77,6 +79,26 @@ static union option_info ecmascript_options[] = {
 		"max_exec_time", 0, 1, 3600, 5,
 		N_("Maximum execution time in seconds for a script.")),
 
+	INIT_OPT_INT("ecmascript", N_("Minimum rerendering interval"),
+		"rerender_interval", 0, 0, 10000, 40,
+		N_("Minimum time in milliseconds between rerenderings of a "
+		"document caused by scripts changing it. Changes made in the "
+		"meantime are collected and rendered at once.")),
+
+#ifdef CONFIG_QUICKJS
+	INIT_OPT_INT("ecmascript", N_("Memory limit"),
+		"memory_limit", 0, 0, 65535, 0,
+		N_("Maximum amount of memory in MiB all scripts together "
+		"may allocate. Scripts exceeding it get an out of memory "
+		"exception. Zero means no limit.")),
+
+	INIT_OPT_INT("ecmascript", N_("Garbage collection threshold"),
+		"gc_threshold", 0, 16, 1048576, 256,
+		N_("Amount of memory in KiB scripts may allocate before "
+		"the garbage collector runs. Higher values trade memory "
+		"for less time spent collecting.")),
+
+#endif
 	INIT_OPT_BOOL("ecmascript", N_("Pop-up window blocking"),
 		"block_window_opening", 0, 0,
 		N_("Whether to disallow scripts to open new windows or tabs.")),
@@ -85,6 +107,10 @@ static union option_info ecmascript_options[] = {
 };
 
 static int interpreter_count;
+static long mutation_count;
+static long rerender_count;
+static long bytecode_hit_count;
+static long bytecode_miss_count;
 
 static INIT_LIST_OF(struct string_list_item, allowed_urls);
 static INIT_LIST_OF(struct string_list_item, disallowed_urls);
@@ -276,19 +302,144 @@ ecmascript_get_interpreter_count(void)
 	return interpreter_count;
 }
 
+long
+ecmascript_get_mutation_count(void)
+{
+	return mutation_count;
+}
+
+long
+ecmascript_get_rerender_count(void)
+{
+	return rerender_count;
+}
+
+long
+ecmascript_get_bytecode_hit_count(void)
+{
+	return bytecode_hit_count;
+}
+
+long
+ecmascript_get_bytecode_miss_count(void)
+{
+	return bytecode_miss_count;
+}
+
+/* The session that opened the rerendering may be gone by the time the timer
+ * fires, so look up whoever is still showing @document. */
+static struct session *
+get_document_session(struct document *document)
+{
+	struct session *ses;
+
+	foreach (ses, sessions) {
+		struct document_view *doc_view;
+
+		if (ses->doc_view && ses->doc_view->document == document)
+			return ses;
+
+		foreach (doc_view, ses->scrn_frames)
+			if (doc_view->document == document)
+				return ses;
+
+		foreach (doc_view, ses->scrn_iframes)
+			if (doc_view->document == document)
+				return ses;
+	}
+
+	return NULL;
+}
+
 static void
 delayed_reload(void *data)
 {
 	struct delayed_rel *rel = data;
+	struct document *document;
+	struct session *ses;
+	struct string text;
 
 	assert(rel);
-	reset_document(rel->document);
-	render_xhtml_document(rel->cached, rel->document, NULL);
-	sort_links(rel->document);
-	draw_formatted(rel->ses, 0);
+	document = rel->document;
+	document->rerender_timer = TIMER_ID_UNDEF;
+	timeval_now(&document->last_rerender);
+
+	if (!init_string(&text)) {
+		object_unlock(document);
+		mem_free(rel);
+		return;
+	}
+
+	/* Scripts often flag the document as changed without touching
+	 * anything visible, so skip the relayout when the serialized tree is
+	 * the same as the one last rendered. */
+	if (dump_xhtml_document(document, &text)
+	    && document->text && !strcmp(document->text, text.source)) {
+		done_string(&text);
+		object_unlock(document);
+		mem_free(rel);
+		return;
+	}
+
+	rerender_count++;
+	reset_document(document);
+
+	if (text.length) {
+		document->text = text.source;
+		render_xhtml_document(rel->cached, document, &text);
+	} else {
+		done_string(&text);
+		render_xhtml_document(rel->cached, document, NULL);
+	}
+
+	sort_links(document);
+	ses = get_document_session(document);
+	if (ses) draw_formatted(ses, 0);
+	object_unlock(document);
 	mem_free(rel);
 }
 
+/* Get how long to wait before rerendering so that rerenderings are at least
+ * ecmascript.rerender_interval apart. */
+static milliseconds_T
+get_rerender_delay(struct document *document)
+{
+	milliseconds_T interval = get_opt_int("ecmascript.rerender_interval", NULL);
+	milliseconds_T elapsed;
+	timeval_T now, diff;
+
+	timeval_now(&now);
+	timeval_sub(&diff, &document->last_rerender, &now);
+	elapsed = timeval_to_milliseconds(&diff);
+
+	return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+/* Called by the backends after a script has added or removed nodes of the
+ * DOM tree. */
+void
+ecmascript_dom_changed(struct ecmascript_interpreter *interpreter)
+{
+	interpreter->changed++;
+
+	if (interpreter->vs->doc_view)
+		invalidate_dom_index(interpreter->vs->doc_view->document);
+}
+
+/* Called by the backends after a script has set the attribute @name of an
+ * element. Only the id and class attributes are indexed. */
+void
+ecmascript_dom_attribute_changed(struct ecmascript_interpreter *interpreter,
+				 const char *name)
+{
+	if (!strcmp(name, "id") || !strcmp(name, "class")) {
+		ecmascript_dom_changed(interpreter);
+		return;
+	}
+
+	interpreter->changed++;
+}
+
 void
 check_for_rerender(struct ecmascript_interpreter *interpreter, const char* text)
 {
@@ -298,24 +449,37 @@ check_for_rerender(struct ecmascript_interpreter *interpreter, const char* text)
 	if (interpreter->changed) {
 		struct document_view *doc_view = interpreter->vs->doc_view;
 		struct document *document = doc_view->document;
-		struct session *ses = doc_view->session;
 		struct cache_entry *cached = document->cached;
 		struct fragment *f = get_cache_fragment(cached);
+		struct delayed_rel *rel;
 
 		//fprintf(stderr, "%s\n", text);
 
-		if (document->dom) {
-			interpreter->changed = false;
+		mutation_count += interpreter->changed;
+		interpreter->changed = 0;
 
-			struct delayed_rel *rel = mem_calloc(1, sizeof(*rel));
+		if (!document->dom)
+			return;
 
-			if (rel) {
-				rel->cached = cached;
-				rel->document = document;
-				rel->ses = ses;
-				object_lock(document);
-				register_bottom_half(delayed_reload, rel);
-			}
+		/* The mutations will be picked up by the already scheduled
+		 * rerendering. */
+		if (document->rerender_timer != TIMER_ID_UNDEF)
+			return;
+
+		rel = mem_calloc(1, sizeof(*rel));
+		if (!rel)
+			return;
+
+		rel->cached = cached;
+		rel->document = document;
+		object_lock(document);
+		install_timer(&document->rerender_timer,
+			      get_rerender_delay(document),
+			      delayed_reload, rel);
+
+		if (document->rerender_timer == TIMER_ID_UNDEF) {
+			object_unlock(document);
+			mem_free(rel);
 		}
 	}
 }
@@ -336,6 +500,25 @@ ecmascript_eval(struct ecmascript_interpreter *interpreter,
 	interpreter->backend_nesting--;
 }
 
+void
+ecmascript_eval_cached(struct ecmascript_interpreter *interpreter,
+                       struct string *code, struct cache_entry *cached)
+{
+	if (!get_ecmascript_enable(interpreter))
+		return;
+	assert(interpreter && cached);
+	interpreter->backend_nesting++;
+#ifdef CONFIG_QUICKJS
+	if (quickjs_eval_cached(interpreter, code, cached))
+		bytecode_hit_count++;
+	else
+		bytecode_miss_count++;
+#else
+	spidermonkey_eval(interpreter, code, NULL);
+#endif
+	interpreter->backend_nesting--;
+}
+
 #ifdef CONFIG_ECMASCRIPT_SMJS
 static void
 ecmascript_call_function(struct ecmascript_interpreter *interpreter,
@@ -636,6 +819,7 @@ done_ecmascript_module(struct module *module)
 {
 	free_string_list(&allowed_urls);
 	mem_free_if(console_log_filename);
+	db_close();
 	mem_free_if(local_storage_filename);
 }
 
@@ -28,6 +28,8 @@
 #include <stdio.h>
 #endif
 
+struct cache_entry;
+struct document;
 struct document_view;
 struct form_state;
 struct form_view;
@@ -85,7 +87,9 @@ struct ecmascript_interpreter {
 #ifdef CONFIG_ECMASCRIPT_SMJS
 	JS::RootedValue fun;
 #endif
-	bool changed;
+	/* Number of DOM mutations since the last rerendering was
+	 * scheduled. */
+	unsigned int changed;
 };
 
 struct delayed_goto {
@@ -112,6 +116,10 @@ void ecmascript_free_urls(struct module *module);
 struct ecmascript_interpreter *ecmascript_get_interpreter(struct view_state*vs);
 void ecmascript_put_interpreter(struct ecmascript_interpreter *interpreter);
 int ecmascript_get_interpreter_count(void);
+long ecmascript_get_mutation_count(void);
+long ecmascript_get_rerender_count(void);
+long ecmascript_get_bytecode_hit_count(void);
+long ecmascript_get_bytecode_miss_count(void);
 
 void ecmascript_detach_form_view(struct form_view *fv);
 void ecmascript_detach_form_state(struct form_state *fs);
@@ -120,6 +128,9 @@ void ecmascript_moved_form_state(struct form_state *fs);
 void ecmascript_reset_state(struct view_state *vs);
 
 void ecmascript_eval(struct ecmascript_interpreter *interpreter, struct string *code, struct string *ret);
+/* Evaluates the script @code loaded into @cached, reusing the compiled form
+ * kept with the cache entry if the backend supports it. */
+void ecmascript_eval_cached(struct ecmascript_interpreter *interpreter, struct string *code, struct cache_entry *cached);
 char *ecmascript_eval_stringback(struct ecmascript_interpreter *interpreter, struct string *code);
 /* Returns -1 if undefined. */
 int ecmascript_eval_boolback(struct ecmascript_interpreter *interpreter, struct string *code);
@@ -145,11 +156,14 @@ void ecmascript_set_timeout2q(struct ecmascript_interpreter *interpreter, JSValu
 int get_ecmascript_enable(struct ecmascript_interpreter *interpreter);
 
 void check_for_rerender(struct ecmascript_interpreter *interpreter, const char* text);
+void ecmascript_dom_changed(struct ecmascript_interpreter *interpreter);
+void ecmascript_dom_attribute_changed(struct ecmascript_interpreter *interpreter, const char *name);
 
 void toggle_ecmascript(struct session *ses);
 
 void *document_parse(struct document *document);
 void free_document(void *doc);
+void invalidate_dom_index(struct document *document);
 void location_goto(struct document_view *doc_view, char *url);
 
 extern char *console_error_filename;
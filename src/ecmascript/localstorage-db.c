@@ -11,174 +11,252 @@
 
 #include "elinks.h"
 #include "src/ecmascript/ecmascript.h"
-
-int
-db_prepare_structure(char *db_name)
+#include "ecmascript/localstorage-db.h"
+#include "main/timer.h"
+#include "util/memory.h"
+#include "util/string.h"
+
+/* The database is opened once and kept open, together with its prepared
+ * statements. Writes are grouped in one transaction, which is committed
+ * from a timer on the next pass through the main loop, so a script
+ * setting many items pays for a single sync. */
+
+enum db_statement {
+	DB_DELETE_FROM,
+	DB_INSERT_INTO,
+	DB_UPDATE_SET,
+	DB_QUERY_BY_VALUE,
+	DB_QUERY_BY_KEY,
+	DB_BEGIN,
+	DB_COMMIT,
+
+	DB_STATEMENTS
+};
+
+static const char *db_statement_sql[DB_STATEMENTS] = {
+	"DELETE FROM storage WHERE key = ?;",
+	"INSERT INTO storage (value,key) VALUES (?,?);",
+	"UPDATE storage SET value = ? where key = ?;",
+	"SELECT key FROM storage WHERE value = ? LIMIT 1;",
+	"SELECT * FROM storage WHERE key = ? LIMIT 1;",
+	"BEGIN;",
+	"COMMIT;",
+};
+
+/* A batch another connection keeps the database locked for is committed
+ * again this many times, this many milliseconds apart. */
+#define DB_COMMIT_RETRIES	5
+#define DB_COMMIT_RETRY_DELAY	500
+
+static sqlite3 *db_handle;
+static char *db_handle_name;
+static sqlite3_stmt *db_statements[DB_STATEMENTS];
+static timer_id_T db_commit_timer = TIMER_ID_UNDEF;
+static int db_commit_retries;
+
+static void db_commit_handler(void *data);
+
+/* Commits the batch. If the database is busy, the commit is tried again
+ * later if @retry is set. Otherwise the batch is rolled back, so that the
+ * next write starts a new one. */
+static void
+db_commit(int retry)
 {
-	sqlite3_stmt *stmt;
-	sqlite3 *db;
+	int result;
 
-	int rc;
+	if (!db_statements[DB_COMMIT]) return;
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc)
-	{
-		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return(-1);
+	result = sqlite3_step(db_statements[DB_COMMIT]);
+	sqlite3_reset(db_statements[DB_COMMIT]);
+
+	/* A failed commit may have ended the transaction anyway. */
+	if (result == SQLITE_DONE || sqlite3_get_autocommit(db_handle)) {
+		db_commit_retries = 0;
+		return;
 	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "CREATE TABLE storage (key TEXT, value TEXT);", -1, &stmt, NULL);
-	rc=sqlite3_step(stmt);
-	rc=sqlite3_finalize(stmt);
-	rc=sqlite3_close(db);
-	return(0);
+
+	if (retry && result == SQLITE_BUSY
+	    && db_commit_retries++ < DB_COMMIT_RETRIES) {
+		install_timer(&db_commit_timer, DB_COMMIT_RETRY_DELAY,
+			      db_commit_handler, NULL);
+		return;
+	}
+
+	db_commit_retries = 0;
+	sqlite3_exec(db_handle, "ROLLBACK;", NULL, NULL, NULL);
 }
 
-int
-db_delete_from(char *db_name, char *key)
+static void
+db_commit_handler(void *data)
 {
+	/* The expired timer ID has been freed already. */
+	db_commit_timer = TIMER_ID_UNDEF;
 
-	sqlite3_stmt *stmt;
-	sqlite3 *db;
+	db_commit(1);
+}
+
+void
+db_close(void)
+{
+	int i;
 
-	int rc;
-	int affected_rows = 0;
+	/* Commit the pending batch now rather than losing it. */
+	if (db_commit_timer != TIMER_ID_UNDEF) {
+		kill_timer(&db_commit_timer);
+		db_commit(0);
+	}
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc)
-	{
-		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return(-1);
+	for (i = 0; i < DB_STATEMENTS; i++) {
+		if (db_statements[i]) {
+			sqlite3_finalize(db_statements[i]);
+			db_statements[i] = NULL;
+		}
 	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "DELETE FROM storage WHERE key = ?;", -1, &stmt, NULL);
-	rc=sqlite3_bind_text(stmt, 1, key, strlen(key), SQLITE_STATIC);
-	rc=sqlite3_step(stmt);
-	rc=sqlite3_finalize(stmt);
-	affected_rows=sqlite3_changes(db);
-	rc=sqlite3_close(db);
-	return(affected_rows);
 
+	if (db_handle) {
+		sqlite3_close(db_handle);
+		db_handle = NULL;
+	}
+	mem_free_set(&db_handle_name, NULL);
 }
 
-
-int
-db_insert_into(char *db_name, char *key, char *value)
+static sqlite3 *
+db_open(char *db_name)
 {
-	sqlite3_stmt *stmt;
-	sqlite3 *db;
+	if (!db_name) return NULL;
 
-	int rc;
-	int affected_rows = 0;
+	if (db_handle) {
+		if (!strcmp(db_handle_name, db_name)) return db_handle;
+		db_close();
+	}
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc) {
+	if (sqlite3_open(db_name, &db_handle)) {
 		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return(-1);
+		sqlite3_close(db_handle);
+		db_handle = NULL;
+		return NULL;
 	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "INSERT INTO storage (value,key) VALUES (?,?);", -1, &stmt, NULL);
-	rc=sqlite3_bind_text(stmt, 1, value, strlen(value), SQLITE_STATIC);
-	rc=sqlite3_bind_text(stmt, 2, key, strlen(key), SQLITE_STATIC);
-	rc=sqlite3_step(stmt);
-	rc=sqlite3_finalize(stmt);
-	affected_rows=sqlite3_changes(db);
-	rc=sqlite3_close(db);
-	return(affected_rows);
+	db_handle_name = stracpy(db_name);
+	sqlite3_busy_timeout(db_handle, 2000);
+	sqlite3_exec(db_handle, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+	sqlite3_exec(db_handle, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
 
+	return db_handle;
 }
 
-int
-db_update_set(char *db_name, char *key, char *value)
+/* Returns the cached, reset statement @which, preparing it on first use. */
+static sqlite3_stmt *
+db_get_statement(char *db_name, enum db_statement which)
 {
+	sqlite3 *db = db_open(db_name);
 
-	sqlite3_stmt *stmt;
-	sqlite3 *db;
-
-	int rc;
-	int affected_rows = 0;
+	if (!db) return NULL;
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc) {
-		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return(-1);
+	if (!db_statements[which]
+	    && sqlite3_prepare_v2(db, db_statement_sql[which], -1, &db_statements[which], NULL) != SQLITE_OK) {
+		db_statements[which] = NULL;
+		return NULL;
 	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "UPDATE storage SET value = ? where key = ?;", -1, &stmt, NULL);
-	rc=sqlite3_bind_text(stmt, 1, value, strlen(value), SQLITE_STATIC);
-	rc=sqlite3_bind_text(stmt, 2, key, strlen(key), SQLITE_STATIC);
-	rc=sqlite3_step(stmt);
-	rc=sqlite3_finalize(stmt);
-	affected_rows=sqlite3_changes(db);
-	rc=sqlite3_close(db);
-	return(affected_rows);
 
+	return db_statements[which];
 }
 
-char *
-db_query_by_value(char *db_name, char *value)
+/* Opens the batch transaction the next write joins, if not open yet. */
+static void
+db_begin(char *db_name)
 {
+	sqlite3_stmt *stmt;
+
+	if (db_commit_timer != TIMER_ID_UNDEF) return;
 
+	stmt = db_get_statement(db_name, DB_BEGIN);
+	if (!stmt || !db_get_statement(db_name, DB_COMMIT)) return;
+
+	if (sqlite3_step(stmt) == SQLITE_DONE) {
+		install_timer(&db_commit_timer, 0, db_commit_handler, NULL);
+	}
+	sqlite3_reset(stmt);
+}
+
+static int
+db_write(char *db_name, enum db_statement which, char *first, char *second)
+{
 	sqlite3_stmt *stmt;
-	sqlite3 *db;
+	int affected_rows;
 
-	int rc;
-	char *result;
+	db_begin(db_name);
+	stmt = db_get_statement(db_name, which);
+	if (!stmt) return -1;
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc)
-	{
-		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return stracpy("");
+	sqlite3_bind_text(stmt, 1, first, strlen(first), SQLITE_STATIC);
+	if (second) {
+		sqlite3_bind_text(stmt, 2, second, strlen(second), SQLITE_STATIC);
 	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "SELECT key FROM storage WHERE value = ? LIMIT 1;", -1, &stmt, NULL);
-	rc=sqlite3_bind_text(stmt, 1, value, strlen(value), SQLITE_STATIC);
-
-	if ((const char*) sqlite3_column_text(stmt,1)!= NULL) {
-		result=stracpy((const char *)sqlite3_column_text(stmt, 1));
-	} else {
-		result=stracpy("");
+	sqlite3_step(stmt);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+	affected_rows = sqlite3_changes(db_handle);
+
+	return affected_rows;
+}
+
+static char *
+db_query(char *db_name, enum db_statement which, int column, char *param)
+{
+	sqlite3_stmt *stmt = db_get_statement(db_name, which);
+	char *result = NULL;
+
+	if (!stmt) return stracpy("");
+
+	sqlite3_bind_text(stmt, 1, param, strlen(param), SQLITE_STATIC);
+	if (sqlite3_step(stmt) == SQLITE_ROW
+	    && sqlite3_column_text(stmt, column) != NULL) {
+		result = stracpy((const char *)sqlite3_column_text(stmt, column));
 	}
-	rc=sqlite3_finalize(stmt);
-	rc=sqlite3_close(db);
-	return(result);
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
 
+	return result ? result : stracpy("");
 }
 
-char *
-db_query_by_key(char *db_name, char *key)
+int
+db_prepare_structure(char *db_name)
 {
+	sqlite3 *db = db_open(db_name);
 
-	sqlite3_stmt *stmt;
-	sqlite3 *db;
+	if (!db) return(-1);
 
-	int rc;
-	char *result;
+	sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS storage (key TEXT, value TEXT);", NULL, NULL, NULL);
+	sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS storage_key ON storage (key);", NULL, NULL, NULL);
+	return(0);
+}
 
-	rc = sqlite3_open(db_name, &db);
-	if (rc)
-	{
-		//DBG("Error opening localStorage database.");
-		rc=sqlite3_close(db);
-		return stracpy("");
-	}
-	sqlite3_busy_timeout(db, 2000);
-	rc=sqlite3_prepare_v2(db, "SELECT * FROM storage WHERE key = ? LIMIT 1;", -1, &stmt, NULL);
-	rc=sqlite3_bind_text(stmt, 1, key, strlen(key), SQLITE_STATIC);
-	rc=sqlite3_step(stmt);
-	if ((const char*) sqlite3_column_text(stmt,1)!= NULL) {
-		result=stracpy((const unsigned char *)sqlite3_column_text(stmt, 1));
-	} else {
-		result = stracpy("");
-	}
-	rc=sqlite3_finalize(stmt);
-	rc=sqlite3_close(db);
-	return(result);
+int
+db_delete_from(char *db_name, char *key)
+{
+	return db_write(db_name, DB_DELETE_FROM, key, NULL);
+}
+
+int
+db_insert_into(char *db_name, char *key, char *value)
+{
+	return db_write(db_name, DB_INSERT_INTO, value, key);
+}
 
+int
+db_update_set(char *db_name, char *key, char *value)
+{
+	return db_write(db_name, DB_UPDATE_SET, value, key);
+}
+
+char *
+db_query_by_value(char *db_name, char *value)
+{
+	return db_query(db_name, DB_QUERY_BY_VALUE, 0, value);
+}
+
+char *
+db_query_by_key(char *db_name, char *key)
+{
+	return db_query(db_name, DB_QUERY_BY_KEY, 1, key);
 }
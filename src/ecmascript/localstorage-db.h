@@ -11,6 +11,7 @@ int db_delete_from(char *db_name, char *key);
 int db_insert_into(char *db_name, char *key, char *value);
 int db_update_set(char *db_name, char *key, char *value);
 char * db_query_by_key(char *db_name, char *key);
-char * db_qry_by_value(char *db_name, char *val);
+char * db_query_by_value(char *db_name, char *value);
+void db_close(void);
 
 #endif
@@ -116,6 +116,39 @@ reported:
 }
 #endif
 
+/* One runtime is shared by all interpreters, each of them getting its
+ * own context. Classes are registered in the runtime once, the atoms and
+ * shapes are shared, and there is a single heap to collect instead of one
+ * per document. */
+static JSRuntime *quickjs_runtime;
+
+static void
+quickjs_set_runtime_limits(JSRuntime *rt)
+{
+	int memory_limit = get_opt_int("ecmascript.memory_limit", NULL);
+	int gc_threshold = get_opt_int("ecmascript.gc_threshold", NULL);
+
+	JS_SetMemoryLimit(rt, memory_limit ? (size_t)memory_limit * 1024 * 1024 : (size_t)-1);
+	JS_SetGCThreshold(rt, (size_t)gc_threshold * 1024);
+}
+
+static JSRuntime *
+quickjs_get_runtime(void)
+{
+	if (!quickjs_runtime) {
+		quickjs_runtime = JS_NewRuntime();
+
+		if (!quickjs_runtime) {
+			return nullptr;
+		}
+		JS_SetInterruptHandler(quickjs_runtime, js_heartbeat_callback, NULL);
+	}
+	/* Pick up changes of the options. */
+	quickjs_set_runtime_limits(quickjs_runtime);
+
+	return quickjs_runtime;
+}
+
 static void
 quickjs_init(struct module *xxx)
 {
@@ -141,7 +174,7 @@ quickjs_get_interpreter(struct ecmascript_interpreter *interpreter)
 	assert(interpreter);
 //	if (!js_module_init_ok) return NULL;
 
-	JSRuntime *rt = JS_NewRuntime();
+	JSRuntime *rt = quickjs_get_runtime();
 	if (!rt) {
 		return nullptr;
 	}
@@ -149,7 +182,6 @@ quickjs_get_interpreter(struct ecmascript_interpreter *interpreter)
 	ctx = JS_NewContext(rt);
 
 	if (!ctx) {
-		JS_FreeRuntime(rt);
 		return nullptr;
 	}
 
@@ -158,7 +190,6 @@ quickjs_get_interpreter(struct ecmascript_interpreter *interpreter)
 
 //	JS::SetWarningReporter(ctx, error_reporter);
 
-	JS_SetInterruptHandler(rt, js_heartbeat_callback, interpreter);
 //	JS::RealmOptions options;
 
 //	JS::RootedObject window_obj(ctx, JS_NewGlobalObject(ctx, &window_class, NULL, JS::FireOnNewGlobalHook, options));
@@ -312,6 +343,18 @@ release_and_fail:
 void
 quickjs_put_interpreter(struct ecmascript_interpreter *interpreter)
 {
+	JSContext *ctx;
+
+	assert(interpreter);
+
+	ctx = interpreter->backend_data;
+
+	if (ctx) {
+		JS_FreeContext(ctx);
+		interpreter->backend_data = NULL;
+		/* Reclaim the cycles left behind by the document. */
+		JS_RunGC(quickjs_runtime);
+	}
 #if 0
 	JSContext *ctx;
 
@@ -380,6 +423,71 @@ quickjs_eval(struct ecmascript_interpreter *interpreter,
 	interpreter->ret = ret;
 	JSValue r = JS_Eval(ctx, code->source, code->length, "", 0);
 	done_heartbeat(interpreter->heartbeat);
+
+	JS_FreeValue(ctx, r);
+}
+
+/* Evaluates an external script. The bytecode it compiles to is kept with
+ * the cache entry and reused as long as @cache_id did not change, which
+ * spares compiling the same libraries on every page and rerendering.
+ * Bytecode written by another QuickJS version is rejected by
+ * JS_ReadObject() and simply compiled again. Returns 1 if the cached
+ * bytecode was used. */
+int
+quickjs_eval_cached(struct ecmascript_interpreter *interpreter,
+                    struct string *code, struct cache_entry *cached)
+{
+	JSContext *ctx;
+	JSValue fun = JS_UNDEFINED;
+	int hit = 0;
+
+	assert(interpreter && cached);
+	ctx = interpreter->backend_data;
+	interpreter->heartbeat = add_heartbeat(interpreter);
+	interpreter->ret = nullptr;
+
+	if (cached->bytecode && cached->bytecode_cache_id == cached->cache_id) {
+		fun = JS_ReadObject(ctx, cached->bytecode, cached->bytecode_length, JS_READ_OBJ_BYTECODE);
+
+		if (JS_IsException(fun)) {
+			JS_FreeValue(ctx, JS_GetException(ctx));
+			fun = JS_UNDEFINED;
+		} else {
+			hit = 1;
+		}
+	}
+
+	if (!hit) {
+		fun = JS_Eval(ctx, code->source, code->length, "",
+			JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+
+		if (!JS_IsException(fun) && !cached->incomplete) {
+			size_t length;
+			uint8_t *buf = JS_WriteObject(ctx, &length, fun, JS_WRITE_OBJ_BYTECODE);
+
+			if (buf) {
+				unsigned char *bytecode = mem_alloc(length);
+
+				if (bytecode) {
+					memcpy(bytecode, buf, length);
+					mem_free_set(&cached->bytecode, bytecode);
+					cached->bytecode_length = length;
+					cached->bytecode_cache_id = cached->cache_id;
+				}
+				js_free(ctx, buf);
+			}
+		}
+	}
+
+	if (!JS_IsException(fun)) {
+		/* JS_EvalFunction() takes over the reference to @fun. */
+		JSValue r = JS_EvalFunction(ctx, fun);
+
+		JS_FreeValue(ctx, r);
+	}
+	done_heartbeat(interpreter->heartbeat);
+
+	return hit;
 }
 
 #if 0
@@ -433,6 +541,7 @@ quickjs_eval_stringback(struct ecmascript_interpreter *interpreter,
 	const char *str, *string;
 	size_t len;
 	str = JS_ToCStringLen(ctx, &len, r);
+	JS_FreeValue(ctx, r);
 
 	if (!str) {
 		return nullptr;
@@ -470,6 +579,7 @@ quickjs_eval_boolback(struct ecmascript_interpreter *interpreter,
 	int ret = -1;
 
 	JS_ToInt32(ctx, &ret, r);
+	JS_FreeValue(ctx, r);
 
 	return ret;
 }
@@ -3,6 +3,7 @@
 
 #include <quickjs/quickjs.h>
 
+struct cache_entry;
 struct ecmascript_interpreter;
 struct form_view;
 struct form_state;
@@ -16,6 +17,7 @@ void quickjs_detach_form_state(struct form_state *fs);
 void quickjs_moved_form_state(struct form_state *fs);
 
 void quickjs_eval(struct ecmascript_interpreter *interpreter, struct string *code, struct string *ret);
+int quickjs_eval_cached(struct ecmascript_interpreter *interpreter, struct string *code, struct cache_entry *cached);
 char *quickjs_eval_stringback(struct ecmascript_interpreter *interpreter, struct string *code);
 int quickjs_eval_boolback(struct ecmascript_interpreter *interpreter, struct string *code);
 
@@ -22,6 +22,7 @@
 #include "document/forms.h"
 #include "document/view.h"
 #include "ecmascript/css2xpath.h"
+#include "ecmascript/dom-index.h"
 #include "ecmascript/ecmascript.h"
 #include "ecmascript/quickjs.h"
 #include "ecmascript/quickjs/collection.h"
@@ -1210,8 +1211,6 @@ js_document_getElementById(JSContext *ctx, JSValueConst this_val, int argc, JSVa
 		return JS_NULL;
 	}
 
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
 	const char *str;
 	size_t len;
 
@@ -1222,18 +1221,13 @@ js_document_getElementById(JSContext *ctx, JSValueConst this_val, int argc, JSVa
 	}
 	xmlpp::ustring id = str;
 	JS_FreeCString(ctx, str);
-	xmlpp::ustring xpath = "//*[@id=\"";
-	xpath += id;
-	xpath += "\"]";
 
-	auto elements = root->find(xpath);
+	xmlpp::Element *node = get_dom_index_element_by_id(document, id);
 
-	if (elements.size() == 0) {
+	if (!node) {
 		return JS_NULL;
 	}
 
-	auto node = elements[0];
-
 	return getElement(ctx, node);
 }
 
@@ -1258,9 +1252,6 @@ js_document_getElementsByClassName(JSContext *ctx, JSValueConst this_val, int ar
 		return JS_NULL;
 	}
 
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
-
 	const char *str;
 	size_t len;
 
@@ -1272,12 +1263,11 @@ js_document_getElementsByClassName(JSContext *ctx, JSValueConst this_val, int ar
 	xmlpp::ustring id = str;
 	JS_FreeCString(ctx, str);
 
-	xmlpp::ustring xpath = "//*[@class=\"";
-	xpath += id;
-	xpath += "\"]";
-	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
+	xmlpp::Node::NodeSet *elements = get_dom_index_elements_by_class_name(document, id);
 
-	*elements = root->find(xpath);
+	if (!elements) {
+		return JS_NULL;
+	}
 
 	return getCollection(ctx, elements);
 }
@@ -1348,8 +1338,6 @@ js_document_getElementsByTagName(JSContext *ctx, JSValueConst this_val, int argc
 	if (!document->dom) {
 		return JS_NULL;
 	}
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
 	const char *str;
 	size_t len;
 
@@ -1360,13 +1348,12 @@ js_document_getElementsByTagName(JSContext *ctx, JSValueConst this_val, int argc
 	}
 	xmlpp::ustring id = str;
 	JS_FreeCString(ctx, str);
-	std::transform(id.begin(), id.end(), id.begin(), ::tolower);
 
-	xmlpp::ustring xpath = "//";
-	xpath += id;
-	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
+	xmlpp::Node::NodeSet *elements = get_dom_index_elements_by_tag_name(document, id);
 
-	*elements = root->find(xpath);
+	if (!elements) {
+		return JS_NULL;
+	}
 
 	return getCollection(ctx, elements);
 }
@@ -1404,12 +1391,10 @@ js_document_querySelector(JSContext *ctx, JSValueConst this_val, int argc, JSVal
 	}
 	xmlpp::ustring css = str;
 	JS_FreeCString(ctx, str);
-	xmlpp::ustring xpath = css2xpath(css);
-
 	xmlpp::Node::NodeSet elements;
 
 	try {
-		elements = root->find(xpath);
+		elements = css_find(root, css);
 	} catch (xmlpp::exception) {
 		return JS_NULL;
 	}
@@ -1456,11 +1441,10 @@ js_document_querySelectorAll(JSContext *ctx, JSValueConst this_val, int argc, JS
 	}
 	xmlpp::ustring css = str;
 	JS_FreeCString(ctx, str);
-	xmlpp::ustring xpath = css2xpath(css);
 	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
 
 	try {
-		*elements = root->find(xpath);
+		*elements = css_find(root, css);
 	} catch (xmlpp::exception) {
 	}
 
@@ -779,7 +779,7 @@ js_element_set_property_className(JSContext *ctx, JSValueConst this_val, JSValue
 	}
 	xmlpp::ustring value = str;
 	el->set_attribute("class", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "class");
 	JS_FreeCString(ctx, str);
 
 	return JS_UNDEFINED;
@@ -808,7 +808,7 @@ js_element_set_property_dir(JSContext *ctx, JSValueConst this_val, JSValue val)
 
 	if (value == "ltr" || value == "rtl" || value == "auto") {
 		el->set_attribute("dir", value);
-		interpreter->changed = true;
+		ecmascript_dom_attribute_changed(interpreter, "dir");
 	}
 	JS_FreeCString(ctx, str);
 
@@ -836,7 +836,7 @@ js_element_set_property_id(JSContext *ctx, JSValueConst this_val, JSValue val)
 	}
 	xmlpp::ustring value = str;
 	el->set_attribute("id", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "id");
 	JS_FreeCString(ctx, str);
 
 	return JS_UNDEFINED;
@@ -884,7 +884,7 @@ js_element_set_property_innerHtml(JSContext *ctx, JSValueConst this_val, JSValue
 	for (; it2 != end2; ++it2) {
 		el->import_node(*it2);
 	}
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return JS_UNDEFINED;
 }
@@ -915,7 +915,7 @@ js_element_set_property_innerText(JSContext *ctx, JSValueConst this_val, JSValue
 		return JS_EXCEPTION;
 	}
 	el->add_child_text(str);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 	JS_FreeCString(ctx, str);
 
 	return JS_UNDEFINED;
@@ -941,7 +941,7 @@ js_element_set_property_lang(JSContext *ctx, JSValueConst this_val, JSValue val)
 	}
 	xmlpp::ustring value = str;
 	el->set_attribute("lang", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "lang");
 	JS_FreeCString(ctx, str);
 
 	return JS_UNDEFINED;
@@ -991,7 +991,7 @@ js_element_set_property_title(JSContext *ctx, JSValueConst this_val, JSValue val
 	}
 	xmlpp::ustring value = str;
 	el->set_attribute("title", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "title");
 	JS_FreeCString(ctx, str);
 
 	return JS_UNDEFINED;
@@ -1049,7 +1049,7 @@ js_element_appendChild(JSContext *ctx, JSValueConst this_val, int argc, JSValueC
 	}
 	xmlpp::Node *el2 = JS_GetOpaque(argv[0], js_element_class_id);
 	el->import_node(el2);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return getElement(ctx, el2);
 }
@@ -1299,7 +1299,7 @@ js_element_insertBefore(JSContext *ctx, JSValueConst this_val, int argc, JSValue
 	auto node = xmlAddPrevSibling(next_sibling->cobj(), child->cobj());
 	auto res = el_add_child_element_common(child->cobj(), node);
 
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return getElement(ctx, res);
 }
@@ -1387,12 +1387,11 @@ js_element_querySelector(JSContext *ctx, JSValueConst this_val, int argc, JSValu
 		return JS_EXCEPTION;
 	}
 	xmlpp::ustring css = str;
-	xmlpp::ustring xpath = css2xpath(css);
 	JS_FreeCString(ctx, str);
 	xmlpp::Node::NodeSet elements;
 
 	try {
-		elements = el->find(xpath);
+		elements = css_find(el, css);
 	} catch (xmlpp::exception) {
 		return JS_NULL;
 	}
@@ -1427,12 +1426,11 @@ js_element_querySelectorAll(JSContext *ctx, JSValueConst this_val, int argc, JSV
 		return JS_EXCEPTION;
 	}
 	xmlpp::ustring css = str;
-	xmlpp::ustring xpath = css2xpath(css);
 	JS_FreeCString(ctx, str);
 	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
 
 	try {
-		*elements = el->find(xpath);
+		*elements = css_find(el, css);
 	} catch (xmlpp::exception) {
 	}
 
@@ -1459,7 +1457,7 @@ js_element_remove(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst
 	}
 
 	xmlpp::Node::remove_node(el);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return JS_UNDEFINED;
 }
@@ -1491,7 +1489,7 @@ js_element_removeChild(JSContext *ctx, JSValueConst this_val, int argc, JSValueC
 	for (;it != end; ++it) {
 		if (*it == el2) {
 			xmlpp::Node::remove_node(el2);
-			interpreter->changed = true;
+			ecmascript_dom_changed(interpreter);
 
 			return getElement(ctx, el2);
 		}
@@ -1536,7 +1534,7 @@ js_element_setAttribute(JSContext *ctx, JSValueConst this_val, int argc, JSValue
 	xmlpp::ustring attr = attr_c;
 	xmlpp::ustring value = value_c;
 	el->set_attribute(attr, value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, attr.c_str());
 	JS_FreeCString(ctx, attr_c);
 	JS_FreeCString(ctx, value_c);
 
@@ -28,14 +28,21 @@ static INIT_LIST_OF(struct heartbeat, heartbeats);
 static struct itimerval heartbeat_timer = { { 1, 0 }, { 1, 0 } };
 
 /* This callback is installed by JS_SetInterruptHandler.
- * Returning 1 terminates script execution immediately. */
+ * Returning 1 terminates script execution immediately.
+ * The runtime is shared by all interpreters, so check the most recently
+ * added heartbeat, which belongs to the script currently running. */
 
 int
 js_heartbeat_callback(JSRuntime *rt, void *opaque)
 {
-	struct ecmascript_interpreter *interpreter = opaque;
+	struct heartbeat *hb;
+
+	if (list_empty(heartbeats)) {
+		return 0;
+	}
+	hb = heartbeats.next;
 
-	if (!interpreter || !interpreter->heartbeat || interpreter->heartbeat->ttl > 0) {
+	if (!hb->interpreter || hb->ttl > 0) {
 		return 0;
 	}
 	return 1;
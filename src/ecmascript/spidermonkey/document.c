@@ -24,6 +24,7 @@
 #include "document/forms.h"
 #include "document/view.h"
 #include "ecmascript/css2xpath.h"
+#include "ecmascript/dom-index.h"
 #include "ecmascript/ecmascript.h"
 #include "ecmascript/spidermonkey/collection.h"
 #include "ecmascript/spidermonkey/form.h"
@@ -1742,30 +1743,21 @@ document_getElementById(JSContext *ctx, unsigned int argc, JS::Value *vp)
 		return true;
 	}
 
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
-
 	struct string idstr;
 
 	init_string(&idstr);
 	jshandle_value_to_char_string(&idstr, ctx, args[0]);
 	xmlpp::ustring id = idstr.source;
 
-	xmlpp::ustring xpath = "//*[@id=\"";
-	xpath += id;
-	xpath += "\"]";
-
 	done_string(&idstr);
 
-	auto elements = root->find(xpath);
+	xmlpp::Element *node = get_dom_index_element_by_id(document, id);
 
-	if (elements.size() == 0) {
+	if (!node) {
 		args.rval().setNull();
 		return true;
 	}
 
-	auto node = elements[0];
-
 	JSObject *elem = getElement(ctx, node);
 
 	if (elem) {
@@ -1804,24 +1796,20 @@ document_getElementsByClassName(JSContext *ctx, unsigned int argc, JS::Value *vp
 		return true;
 	}
 
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
-
 	struct string idstr;
 
 	init_string(&idstr);
 	jshandle_value_to_char_string(&idstr, ctx, args[0]);
 	xmlpp::ustring id = idstr.source;
 
-	xmlpp::ustring xpath = "//*[@class=\"";
-	xpath += id;
-	xpath += "\"]";
-
 	done_string(&idstr);
 
-	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
+	xmlpp::Node::NodeSet *elements = get_dom_index_elements_by_class_name(document, id);
 
-	*elements = root->find(xpath);
+	if (!elements) {
+		args.rval().setNull();
+		return true;
+	}
 
 	JSObject *elem = getCollection(ctx, elements);
 
@@ -1919,24 +1907,20 @@ document_getElementsByTagName(JSContext *ctx, unsigned int argc, JS::Value *vp)
 		args.rval().setNull();
 		return true;
 	}
-	xmlpp::Document *docu = (xmlpp::Document *)document->dom;
-	xmlpp::Element* root = (xmlpp::Element *)docu->get_root_node();
-
 	struct string idstr;
 
 	init_string(&idstr);
 	jshandle_value_to_char_string(&idstr, ctx, args[0]);
 	xmlpp::ustring id = idstr.source;
-	std::transform(id.begin(), id.end(), id.begin(), ::tolower);
-
-	xmlpp::ustring xpath = "//";
-	xpath += id;
 
 	done_string(&idstr);
 
-	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
+	xmlpp::Node::NodeSet *elements = get_dom_index_elements_by_tag_name(document, id);
 
-	*elements = root->find(xpath);
+	if (!elements) {
+		args.rval().setNull();
+		return true;
+	}
 
 	JSObject *elem = getCollection(ctx, elements);
 
@@ -1985,14 +1969,12 @@ document_querySelector(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	jshandle_value_to_char_string(&cssstr, ctx, args[0]);
 	xmlpp::ustring css = cssstr.source;
 
-	xmlpp::ustring xpath = css2xpath(css);
-
 	done_string(&cssstr);
 
 	xmlpp::Node::NodeSet elements;
 
 	try {
-		elements = root->find(xpath);
+		elements = css_find(root, css);
 	} catch (xmlpp::exception) {
 		args.rval().setNull();
 		return true;
@@ -2052,14 +2034,12 @@ document_querySelectorAll(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	jshandle_value_to_char_string(&cssstr, ctx, args[0]);
 	xmlpp::ustring css = cssstr.source;
 
-	xmlpp::ustring xpath = css2xpath(css);
-
 	done_string(&cssstr);
 
 	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
 
 	try {
-		*elements = root->find(xpath);
+		*elements = css_find(root, css);
 	} catch (xmlpp::exception) {
 	}
 
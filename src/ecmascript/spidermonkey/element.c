@@ -1895,7 +1895,7 @@ element_set_property_className(JSContext *ctx, unsigned int argc, JS::Value *vp)
 
 	xmlpp::ustring value = val;
 	el->set_attribute("class", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "class");
 	mem_free_if(val);
 
 	return true;
@@ -1946,7 +1946,7 @@ element_set_property_dir(JSContext *ctx, unsigned int argc, JS::Value *vp)
 
 	if (value == "ltr" || value == "rtl" || value == "auto") {
 		el->set_attribute("dir", value);
-		interpreter->changed = true;
+		ecmascript_dom_attribute_changed(interpreter, "dir");
 	}
 	mem_free_if(val);
 
@@ -1997,7 +1997,7 @@ element_set_property_id(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	char *val = jsval_to_string(ctx, args[0]);
 	xmlpp::ustring value = val;
 	el->set_attribute("id", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "id");
 
 	mem_free_if(val);
 
@@ -2069,7 +2069,7 @@ element_set_property_innerHtml(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	for (; it2 != end2; ++it2) {
 		el->import_node(*it2);
 	}
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return true;
 }
@@ -2124,7 +2124,7 @@ element_set_property_innerText(JSContext *ctx, unsigned int argc, JS::Value *vp)
 
 	char *text = jsval_to_string(ctx, args[0]);
 	el->add_child_text(text);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 	mem_free_if(text);
 
 	return true;
@@ -2173,7 +2173,7 @@ element_set_property_lang(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	char *val = jsval_to_string(ctx, args[0]);
 	xmlpp::ustring value = val;
 	el->set_attribute("lang", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "lang");
 
 	mem_free_if(val);
 
@@ -2300,7 +2300,7 @@ element_set_property_title(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	char *val = jsval_to_string(ctx, args[0]);
 	xmlpp::ustring value = val;
 	el->set_attribute("title", value);
-	interpreter->changed = true;
+	ecmascript_dom_attribute_changed(interpreter, "title");
 
 	mem_free_if(val);
 
@@ -2415,7 +2415,7 @@ element_appendChild(JSContext *ctx, unsigned int argc, JS::Value *rval)
 	JS::RootedObject node(ctx, &args[0].toObject());
 	xmlpp::Node *el2 = JS_GetPrivate(node);
 	el->import_node(el2);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	JSObject *obj = getElement(ctx, el2);
 	if (obj) {
@@ -2799,7 +2799,7 @@ element_insertBefore(JSContext *ctx, unsigned int argc, JS::Value *rval)
 
 	JSObject *elem = getElement(ctx, res);
 	args.rval().setObject(*elem);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return true;
 }
@@ -2934,13 +2934,12 @@ element_querySelector(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	jshandle_value_to_char_string(&cssstr, ctx, args[0]);
 	xmlpp::ustring css = cssstr.source;
 
-	xmlpp::ustring xpath = css2xpath(css);
 	done_string(&cssstr);
 
 	xmlpp::Node::NodeSet elements;
 
 	try {
-		elements = el->find(xpath);
+		elements = css_find(el, css);
 	} catch (xmlpp::exception) {
 		args.rval().setNull();
 		return true;
@@ -2998,14 +2997,12 @@ element_querySelectorAll(JSContext *ctx, unsigned int argc, JS::Value *vp)
 	jshandle_value_to_char_string(&cssstr, ctx, args[0]);
 	xmlpp::ustring css = cssstr.source;
 
-	xmlpp::ustring xpath = css2xpath(css);
-
 	done_string(&cssstr);
 
 	xmlpp::Node::NodeSet *elements = new xmlpp::Node::NodeSet;
 
 	try {
-		*elements = el->find(xpath);
+		*elements = css_find(el, css);
 	} catch (xmlpp::exception) {
 	}
 
@@ -3054,7 +3051,7 @@ element_remove(JSContext *ctx, unsigned int argc, JS::Value *rval)
 	}
 
 	xmlpp::Node::remove_node(el);
-	interpreter->changed = true;
+	ecmascript_dom_changed(interpreter);
 
 	return true;
 }
@@ -3103,7 +3100,7 @@ element_removeChild(JSContext *ctx, unsigned int argc, JS::Value *rval)
 	for (;it != end; ++it) {
 		if (*it == el2) {
 			xmlpp::Node::remove_node(el2);
-			interpreter->changed = true;
+			ecmascript_dom_changed(interpreter);
 			JSObject *obj = getElement(ctx, el2);
 			if (obj) {
 				args.rval().setObject(*obj);
@@ -3156,7 +3153,7 @@ element_setAttribute(JSContext *ctx, unsigned int argc, JS::Value *rval)
 		char *value_c = jsval_to_string(ctx, args[1]);
 		xmlpp::ustring value = value_c;
 		el->set_attribute(attr, value);
-		interpreter->changed = true;
+		ecmascript_dom_attribute_changed(interpreter, attr.c_str());
 		mem_free_if(attr_c);
 		mem_free_if(value_c);
 	}
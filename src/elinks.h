@@ -29,6 +29,12 @@
 #define DEBUG_MEMLEAK
 #endif
 
+/* The memory pool replaces mem_alloc(), which the leak debugger and the
+ * fast mode already do in their own way. */
+#if defined(CONFIG_MEMPOOL) && (defined(DEBUG_MEMLEAK) || defined(CONFIG_FASTMEM))
+#undef CONFIG_MEMPOOL
+#endif
+
 /* This maybe overrides some of the standard high-level functions, to ensure
  * the expected behaviour. These overrides are not system specific. */
 #include "osdep/stub.h"
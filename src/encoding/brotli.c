@@ -160,6 +160,33 @@ brotli_decode_buffer(struct stream_encoded *st, char *datac, int len, int *new_l
 	return NULL;
 }
 
+static int
+brotli_decode(struct stream_encoded *st, char *data, int len, int *used,
+	      char *out, int out_len)
+{
+	struct br_enc_data *enc_data = (struct br_enc_data *)st->data;
+	const uint8_t *next_in = (const uint8_t *)data;
+	uint8_t *next_out = (uint8_t *)out;
+	size_t avail_in = len;
+	size_t avail_out = out_len;
+	BrotliDecoderResult result;
+
+	*used = len;
+	if (enc_data->after_end) return 0;
+
+	result = BrotliDecoderDecompressStream(enc_data->state, &avail_in, &next_in,
+	&avail_out, &next_out, NULL);
+
+	if (result == BROTLI_DECODER_RESULT_ERROR) return -1;
+	if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+		enc_data->after_end = 1;
+	} else {
+		*used = len - avail_in;
+	}
+
+	return out_len - avail_out;
+}
+
 static void
 brotli_close(struct stream_encoded *stream)
 {
@@ -183,5 +210,6 @@ const struct decoding_backend brotli_decoding_backend = {
 	brotli_open,
 	brotli_read,
 	brotli_decode_buffer,
+	brotli_decode,
 	brotli_close,
 };
@@ -195,6 +195,35 @@ bzip2_decode_buffer(struct stream_encoded *st, char *data, int len, int *new_len
 	}
 }
 
+static int
+bzip2_decode(struct stream_encoded *st, char *data, int len, int *used,
+	     char *out, int out_len)
+{
+	struct bz2_enc_data *enc_data = (struct bz2_enc_data *)st->data;
+	bz_stream *stream = &enc_data->fbz_stream;
+	int error;
+
+	*used = len;
+	if (enc_data->after_end) return 0;
+
+	stream->next_in = data;
+	stream->avail_in = len;
+	stream->next_out = out;
+	stream->avail_out = out_len;
+
+	error = BZ2_bzDecompress(stream);
+	if (error == BZ_STREAM_END) {
+		BZ2_bzDecompressEnd(stream);
+		enc_data->after_end = 1;
+		return out_len - stream->avail_out;
+	}
+
+	if (error != BZ_OK) return -1;
+
+	*used = len - stream->avail_in;
+	return out_len - stream->avail_out;
+}
+
 static void
 bzip2_close(struct stream_encoded *stream)
 {
@@ -220,5 +249,6 @@ const struct decoding_backend bzip2_decoding_backend = {
 	bzip2_open,
 	bzip2_read,
 	bzip2_decode_buffer,
+	bzip2_decode,
 	bzip2_close,
 };
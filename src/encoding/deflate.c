@@ -247,6 +247,50 @@ deflate_gzip_decode_buffer(struct stream_encoded *st, char *data, int len, int *
 	return deflate_decode_buffer(st, MAX_WBITS + 32, data, len, new_len);
 }
 
+static int
+deflate_decode(struct stream_encoded *st, char *data, int len, int *used,
+	       char *out, int out_len)
+{
+	struct deflate_enc_data *enc_data = (struct deflate_enc_data *) st->data;
+	z_stream *stream = &enc_data->deflate_stream;
+	int error;
+
+	*used = len;
+	if (enc_data->after_end) return 0;
+
+	stream->next_in = (unsigned char *)data;
+	stream->avail_in = len;
+	stream->next_out = (unsigned char *)out;
+	stream->avail_out = out_len;
+
+	error = inflate(stream, Z_SYNC_FLUSH);
+	if (error == Z_DATA_ERROR && !enc_data->after_first_read) {
+		/* Missing zlib header, see deflate_read(). */
+		(void)inflateEnd(stream);
+		error = inflateInit2(stream, -MAX_WBITS);
+		if (error == Z_OK) {
+			stream->next_in = (unsigned char *)data;
+			stream->avail_in = len;
+			stream->next_out = (unsigned char *)out;
+			stream->avail_out = out_len;
+			error = inflate(stream, Z_SYNC_FLUSH);
+		}
+	}
+	if (len) enc_data->after_first_read = 1;
+
+	if (error == Z_STREAM_END) {
+		inflateEnd(stream);
+		enc_data->after_end = 1;
+		return out_len - stream->avail_out;
+	}
+
+	/* Z_BUF_ERROR only means that no progress was possible. */
+	if (error != Z_OK && error != Z_BUF_ERROR) return -1;
+
+	*used = len - stream->avail_in;
+	return out_len - stream->avail_out;
+}
+
 static void
 deflate_close(struct stream_encoded *stream)
 {
@@ -272,6 +316,7 @@ const struct decoding_backend deflate_decoding_backend = {
 	deflate_raw_open,
 	deflate_read,
 	deflate_raw_decode_buffer,
+	deflate_decode,
 	deflate_close,
 };
 
@@ -283,5 +328,6 @@ const struct decoding_backend gzip_decoding_backend = {
 	deflate_gzip_open,
 	deflate_read,
 	deflate_gzip_decode_buffer,
+	deflate_decode,
 	deflate_close,
 };
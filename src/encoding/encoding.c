@@ -62,6 +62,17 @@ dummy_decode_buffer(struct stream_encoded *stream, char *data, int len, int *new
 	return buffer;
 }
 
+static int
+dummy_decode(struct stream_encoded *stream, char *data, int len, int *used,
+	     char *out, int out_len)
+{
+	int length = len < out_len ? len : out_len;
+
+	memcpy(out, data, length);
+	*used = length;
+	return length;
+}
+
 static void
 dummy_close(struct stream_encoded *stream)
 {
@@ -77,6 +88,7 @@ static const struct decoding_backend dummy_decoding_backend = {
 	dummy_open,
 	dummy_read,
 	dummy_decode_buffer,
+	dummy_decode,
 	dummy_close,
 };
 
@@ -141,6 +153,20 @@ decode_encoded_buffer(struct stream_encoded *stream, enum stream_encoding encodi
 	return decoding_backends[encoding]->decode_buffer(stream, data, len, new_len);
 }
 
+/* Decode the next part of a stream from a buffer. Of the @len bytes at
+ * @data, *@used are consumed and decoded into at most @out_len bytes at
+ * @out, so the caller can keep the decoded data in pieces of bounded size.
+ * Decoding @out_len bytes may leave more decoded data pending, which the
+ * next call returns even if no more data is given. Returns the number of
+ * decoded bytes, or -1 on error. */
+int
+decode_encoded(struct stream_encoded *stream, char *data, int len, int *used,
+	       char *out, int out_len)
+{
+	return decoding_backends[stream->encoding]->decode(stream, data, len,
+							    used, out, out_len);
+}
+
 /* Closes encoded stream. Note that fd associated with the stream will be
  * closed here. */
 void
@@ -295,8 +321,11 @@ is_stdin_pipe(struct stat *stt, struct string *filename)
 			S_ISFIFO(stt->st_mode));
 }
 
+/* Opens the file with the given @filename, or one with an encoding extension
+ * appended, as *@streamp. *@readsize is set to the size of the file. */
 struct connection_state
-read_encoded_file(struct string *filename, struct string *page)
+open_encoded_file(struct string *filename, struct stream_encoded **streamp,
+		  int *readsize)
 {
 	struct stream_encoded *stream;
 	struct stat stt;
@@ -341,23 +370,40 @@ read_encoded_file(struct string *filename, struct string *page)
 		state = connection_state(S_OUT_OF_MEM);
 
 	} else {
-		int readsize = (int) stt.st_size;
+		*readsize = (int) stt.st_size;
 
 		/* Check if st_size will cause overflow. */
 		/* FIXME: See bug 497 for info about support for big files. */
-		if (readsize != stt.st_size || readsize < 0) {
+		if (*readsize != stt.st_size || *readsize < 0) {
 #ifdef EFBIG
 			state = connection_state_for_errno(EFBIG);
 #else
 			state = connection_state(S_FILE_ERROR);
 #endif
-
-		} else {
-			state = read_file(stream, stt.st_size, page);
+			/* This closes @fd too. */
+			close_encoded(stream);
+			return state;
 		}
-		close_encoded(stream);
+
+		*streamp = stream;
+		return connection_state(S_OK);
 	}
 
 	close(fd);
 	return state;
 }
+
+struct connection_state
+read_encoded_file(struct string *filename, struct string *page)
+{
+	struct stream_encoded *stream;
+	int readsize;
+	struct connection_state state;
+
+	state = open_encoded_file(filename, &stream, &readsize);
+	if (!is_in_state(state, S_OK)) return state;
+
+	state = read_file(stream, readsize, page);
+	close_encoded(stream);
+	return state;
+}
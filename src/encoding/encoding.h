@@ -32,12 +32,14 @@ struct decoding_backend {
 	int (*open)(struct stream_encoded *stream, int fd);
 	int (*read)(struct stream_encoded *stream, char *data, int len);
 	char *(*decode_buffer)(struct stream_encoded *stream, char *data, int len, int *new_len);
+	int (*decode)(struct stream_encoded *stream, char *data, int len, int *used, char *out, int out_len);
 	void (*close)(struct stream_encoded *stream);
 };
 
 struct stream_encoded *open_encoded(int, enum stream_encoding);
 int read_encoded(struct stream_encoded *, char *, int);
 char *decode_encoded_buffer(struct stream_encoded *stream, enum stream_encoding encoding, char *data, int len, int *new_len);
+int decode_encoded(struct stream_encoded *stream, char *data, int len, int *used, char *out, int out_len);
 void close_encoded(struct stream_encoded *);
 
 const char *const *listext_encoded(enum stream_encoding);
@@ -48,6 +50,9 @@ const char *get_encoding_name(enum stream_encoding encoding);
 struct connection_state
 read_file(struct stream_encoded *stream, int readsize, struct string *page);
 
+/* Opens the file with the given @filename for reading with read_encoded(). */
+struct connection_state open_encoded_file(struct string *filename, struct stream_encoded **stream, int *readsize);
+
 /* Reads the file with the given @filename into the string @source. */
 struct connection_state read_encoded_file(struct string *filename, struct string *source);
 
@@ -159,6 +159,36 @@ lzma_decode_buffer(struct stream_encoded *st, char *data, int len, int *new_len)
 	}
 }
 
+static int
+lzma_decode(struct stream_encoded *st, char *data, int len, int *used,
+	    char *out, int out_len)
+{
+	struct lzma_enc_data *enc_data = (struct lzma_enc_data *) st->data;
+	lzma_stream *stream = &enc_data->flzma_stream;
+	int error;
+
+	*used = len;
+	if (enc_data->after_end) return 0;
+
+	/* The decoder was set up by lzma_open(). */
+	stream->next_in = (const uint8_t *)data;
+	stream->avail_in = len;
+	stream->next_out = (uint8_t *)out;
+	stream->avail_out = out_len;
+
+	error = lzma_code(stream, LZMA_RUN);
+	if (error == LZMA_STREAM_END) {
+		lzma_end(stream);
+		enc_data->after_end = 1;
+		return out_len - stream->avail_out;
+	}
+
+	if (error != LZMA_OK && error != LZMA_BUF_ERROR) return -1;
+
+	*used = len - stream->avail_in;
+	return out_len - stream->avail_out;
+}
+
 static void
 lzma_close(struct stream_encoded *stream)
 {
@@ -184,5 +214,6 @@ const struct decoding_backend lzma_decoding_backend = {
 	lzma_open,
 	lzma_read,
 	lzma_decode_buffer,
+	lzma_decode,
 	lzma_close,
 };
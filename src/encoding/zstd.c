@@ -151,6 +151,21 @@ zstd_read(struct stream_encoded *stream, char *buf, int len)
 	return -1;
 }
 
+static int
+zstd_decode(struct stream_encoded *st, char *data, int len, int *used,
+	    char *out, int out_len)
+{
+	struct zstd_enc_data *enc_data = (struct zstd_enc_data *)st->data;
+	ZSTD_inBuffer input = { data, (size_t)len, 0 };
+	ZSTD_outBuffer output = { out, (size_t)out_len, 0 };
+	size_t error;
+
+	error = ZSTD_decompressStream(enc_data->zstd_stream, &output, &input);
+	if (ZSTD_isError(error)) return -1;
+
+	*used = input.pos;
+	return output.pos;
+}
 
 static void
 zstd_close(struct stream_encoded *stream)
@@ -178,5 +193,6 @@ const struct decoding_backend zstd_decoding_backend = {
 	zstd_open,
 	zstd_read,
 	zstd_decode_buffer,
+	zstd_decode,
 	zstd_close,
 };
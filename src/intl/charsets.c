@@ -14,6 +14,7 @@
 
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 #if HAVE_WCTYPE_H
 #include <wctype.h>
 #endif
@@ -23,6 +24,10 @@
 #include <iconv.h>
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "elinks.h"
 
 #include "document/options.h"
@@ -1269,6 +1274,43 @@ end:
 	return result;
 }
 
+/* Returns how many of the @length bytes at @chars convert_string() can copy
+ * as they are. Bytes from 128 up only qualify with @high_ok and '&' only
+ * with @amp_ok. Most text is ASCII, so the bytes are tested 16 at a time
+ * where SSE2 is available. */
+static inline int
+count_plain_bytes(const unsigned char *chars, int length, int high_ok,
+		  int amp_ok)
+{
+	int i = 0;
+
+	if (high_ok && amp_ok) return length;
+
+#ifdef __SSE2__
+	{
+		const __m128i amp = _mm_set1_epi8('&');
+
+		for (; i + 16 <= length; i += 16) {
+			__m128i block = _mm_loadu_si128((const __m128i *) (chars + i));
+			int mask = 0;
+
+			if (!high_ok) mask = _mm_movemask_epi8(block);
+			if (!amp_ok) mask |= _mm_movemask_epi8(_mm_cmpeq_epi8(block, amp));
+
+			/* The loop below finds the exact position. */
+			if (mask) break;
+		}
+	}
+#endif
+
+	for (; i < length; i++) {
+		if ((!high_ok && chars[i] >= 128) || (!amp_ok && chars[i] == '&'))
+			break;
+	}
+
+	return i;
+}
+
 char *
 convert_string(struct conv_table *convert_table,
 	       char *chars2, int charslen2, int cp,
@@ -1277,10 +1319,13 @@ convert_string(struct conv_table *convert_table,
 	       void *callback_data)
 {
 	char *buffer;
+	int buffersize = ALLOC_GR;
 	int bufferpos = 0;
 	int charspos = 0;
 	unsigned char *chars = (unsigned char *)chars2;
 	int charslen = charslen2;
+	int copy_high = !convert_table;
+	int copy_amp = (mode == CSM_FORM || mode == CSM_NONE);
 
 #ifdef HAVE_ICONV
 	static char iconv_input[256];
@@ -1298,6 +1343,7 @@ convert_string(struct conv_table *convert_table,
 			if (charslen) callback(callback_data, (char *)chars, charslen);
 			return NULL;
 		} else {
+			if (length) *length = charslen;
 			return memacpy((char *)chars, charslen);
 		}
 	}
@@ -1314,7 +1360,7 @@ convert_string(struct conv_table *convert_table,
 
 	/* Buffer allocation */
 
-	buffer = mem_alloc(ALLOC_GR + 1 /* trailing \0 */);
+	buffer = mem_alloc(buffersize + 1 /* trailing \0 */);
 	if (!buffer) return NULL;
 
 #ifdef HAVE_ICONV
@@ -1387,6 +1433,21 @@ out:
 		goto flush; \
 	} while (0)
 
+		/* Copy the bytes needing no conversion up to the next
+		 * flush in one go. */
+		if (chars[charspos] < 128 && chars[charspos] != '&') {
+			int room = ALLOC_GR - (bufferpos & (ALLOC_GR - 1));
+			int run = count_plain_bytes(&chars[charspos],
+						    int_min(charslen - charspos, room),
+						    copy_high, copy_amp);
+
+			memcpy(&buffer[bufferpos], &chars[charspos], run);
+			bufferpos += run;
+			charspos += run;
+			translit = "";
+			goto flush;
+		}
+
 		if (chars[charspos] != '&') {
 			struct conv_table *t;
 			int i;
@@ -1458,13 +1519,16 @@ flush:
 				buffer[bufferpos] = 0;
 				callback(callback_data, buffer, bufferpos);
 				bufferpos = 0;
-			} else {
-				new_ = mem_realloc(buffer, bufferpos + ALLOC_GR);
+			} else if (bufferpos == buffersize) {
+				/* Grow geometrically, long strings would be
+				 * copied over and over otherwise. */
+				new_ = mem_realloc(buffer, buffersize * 2 + 1);
 				if (!new_) {
 					mem_free(buffer);
 					return NULL;
 				}
 				buffer = new_;
+				buffersize *= 2;
 			}
 		}
 #undef PUTC
@@ -0,0 +1,200 @@
+/* Test convert_string() around the ends of its runs of plain bytes */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elinks.h"
+
+#include "intl/charsets.h"
+#include "util/memory.h"
+#include "util/string.h"
+#include "util/test.h"
+
+/* Long enough to span a few flushes of the output buffer. */
+#define TEST_LENGTH	600
+
+/* Where convert_string() stops a run: at the end of a 16 byte block
+ * tested at once and at the 256 byte flush of its buffer. */
+static const int test_offsets[] = { 15, 16, 255, 256 };
+
+enum special {
+	SPECIAL_AMP,
+	SPECIAL_HIGH,
+};
+
+struct test_conversion {
+	const char *name;
+	struct conv_table *table;
+	enum convert_string_mode mode;
+};
+
+static int count_ok, count_fail;
+
+static void
+add_callback_output(void *data, char *buf, int buflen)
+{
+	add_bytes_to_string((struct string *) data, buf, buflen);
+}
+
+/* Appends the @special to @source and what the conversion should make of
+ * it to @expected. */
+static void
+add_special(struct string *source, struct string *expected,
+	    enum special special, struct test_conversion *conversion)
+{
+	if (special == SPECIAL_AMP) {
+		add_to_string(source, "&amp;");
+		add_to_string(expected, conversion->mode == CSM_DEFAULT
+			      ? "&" : "&amp;");
+	} else {
+		/* LATIN SMALL LETTER E WITH ACUTE in ISO-8859-1 */
+		add_char_to_string(source, 0xE9);
+		add_to_string(expected, conversion->table ? "\xC3\xA9" : "\xE9");
+	}
+}
+
+/* Builds a source with the @special at each of the @count @offsets, or
+ * right after the previous one, and letters everywhere else. Checks that
+ * it is converted right with and without a callback. */
+static void
+test_offsets_conversion(const int *offsets, int count, enum special special,
+			struct test_conversion *conversion, int utf8_cp)
+{
+	struct string source, expected, output;
+	char *result;
+	int i, length, callback;
+
+	if (!init_string(&source) || !init_string(&expected))
+		die("out of memory");
+
+	for (i = 0; source.length < TEST_LENGTH; ) {
+		if (i < count && source.length >= offsets[i]) {
+			add_special(&source, &expected, special, conversion);
+			i++;
+		} else {
+			unsigned char c = 'a' + source.length % 26;
+
+			add_char_to_string(&source, c);
+			add_char_to_string(&expected, c);
+		}
+	}
+
+	for (callback = 0; callback <= 1; callback++) {
+		if (!init_string(&output))
+			die("out of memory");
+
+		if (callback) {
+			result = convert_string(conversion->table,
+						source.source, source.length,
+						utf8_cp, conversion->mode,
+						NULL, add_callback_output,
+						&output);
+			if (result)
+				die("convert_string() returned a string "
+				    "with a callback");
+		} else {
+			result = convert_string(conversion->table,
+						source.source, source.length,
+						utf8_cp, conversion->mode,
+						&length, NULL, NULL);
+			if (!result)
+				die("convert_string() failed");
+			add_bytes_to_string(&output, result, length);
+			mem_free(result);
+		}
+
+		if (output.length == expected.length
+		    && !memcmp(output.source, expected.source, expected.length)) {
+			count_ok++;
+		} else {
+			fprintf(stderr, "convert_string() test failed\n"
+				"\tConversion: %s\n"
+				"\tSpecial: %s at offset %d%s\n"
+				"\tCallback: %s\n"
+				"\tActual length: %d\n"
+				"\tCorrect length: %d\n",
+				conversion->name,
+				special == SPECIAL_AMP ? "&amp;" : "high byte",
+				offsets[0], count > 1 ? " and more" : "",
+				callback ? "yes" : "no",
+				output.length, expected.length);
+			count_fail++;
+		}
+
+		done_string(&output);
+	}
+
+	done_string(&source);
+	done_string(&expected);
+}
+
+static void
+test_conversion(struct test_conversion *conversion, int utf8_cp)
+{
+	int special, offset, i;
+
+	for (special = SPECIAL_AMP; special <= SPECIAL_HIGH; special++) {
+		/* The specials on their own and all at once. */
+		for (i = 0; i < sizeof_array(test_offsets); i++)
+			test_offsets_conversion(&test_offsets[i], 1, special,
+						conversion, utf8_cp);
+
+		test_offsets_conversion(test_offsets, sizeof_array(test_offsets),
+					special, conversion, utf8_cp);
+
+		/* And at every other offset up to past the first flush. */
+		for (offset = 0; offset < 300; offset++)
+			test_offsets_conversion(&offset, 1, special,
+						conversion, utf8_cp);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	struct test_conversion conversion;
+	int latin1_cp, utf8_cp;
+
+	init_charsets_lookup();
+	latin1_cp = get_cp_index("ISO-8859-1");
+	utf8_cp = get_cp_index("UTF-8");
+
+	if (latin1_cp < 0 || utf8_cp < 0)
+		die("missing codepages");
+
+	/* Without a table, high bytes are copied as they are. */
+	conversion.name = "copy, no entities";
+	conversion.table = NULL;
+	conversion.mode = CSM_NONE;
+	test_conversion(&conversion, utf8_cp);
+
+	conversion.name = "copy, entities";
+	conversion.mode = CSM_DEFAULT;
+	test_conversion(&conversion, utf8_cp);
+
+	/* Only one translation table is valid at a time. */
+	conversion.table = get_translation_table(latin1_cp, utf8_cp);
+	if (!conversion.table)
+		die("no ISO-8859-1 to UTF-8 table");
+
+	conversion.name = "ISO-8859-1 to UTF-8, no entities";
+	conversion.mode = CSM_NONE;
+	test_conversion(&conversion, utf8_cp);
+
+	conversion.name = "ISO-8859-1 to UTF-8, entities";
+	conversion.mode = CSM_DEFAULT;
+	test_conversion(&conversion, utf8_cp);
+
+	printf("Summary of convert_string() tests: %d OK, %d failed.\n",
+	       count_ok, count_fail);
+
+	free_charsets_lookup();
+
+	return count_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
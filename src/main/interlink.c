@@ -95,6 +95,13 @@ static struct socket_info s_info_listen;
 /* Connect socket info */
 static struct socket_info s_info_connect;
 
+/* Dump server accepted and listening socket info */
+static struct socket_info s_info_dump_accept;
+static struct socket_info s_info_dump_listen;
+
+/* Handler of the connections accepted by the dump server. */
+static void (*dump_connection_handler)(int fd);
+
 /* Type of address requested (for get_address()) */
 enum addr_type {
 	ADDR_IP_CLIENT,
@@ -112,7 +119,7 @@ enum addr_type {
  * to free anything).
  * It returns 1 on success. */
 static int
-get_sun_path(struct string *sun_path)
+get_sun_path(struct string *sun_path, const char *name)
 {
 	assert(sun_path);
 	if_assert_failed return 0;
@@ -122,7 +129,7 @@ get_sun_path(struct string *sun_path)
 	if (!init_string(sun_path)) return 0;
 
 	add_to_string(sun_path, elinks_home);
-	add_to_string(sun_path, ELINKS_SOCK_NAME);
+	add_to_string(sun_path, name);
 	add_long_to_string(sun_path,
 			   get_cmd_opt_int("session-ring"));
 
@@ -131,7 +138,7 @@ get_sun_path(struct string *sun_path)
 
 /* @type is ignored here => always local. */
 static int
-get_address(struct socket_info *info, enum addr_type type)
+get_address(struct socket_info *info, enum addr_type type, const char *name)
 {
 	struct sockaddr_un *addr = NULL;
 	int sun_path_freespace;
@@ -140,7 +147,7 @@ get_address(struct socket_info *info, enum addr_type type)
 	assert(info);
 	if_assert_failed return -1;
 
-	if (!get_sun_path(&path)) return -1;
+	if (!get_sun_path(&path, name)) return -1;
 
 	/* Linux defines that as:
 	 * #define UNIX_PATH_MAX   108
@@ -249,17 +256,25 @@ unlink_unix(struct sockaddr *addr)
 /* @type is not used for now, and is ignored, it will
  * be used in remote mode feature. */
 static int
-get_address(struct socket_info *info, enum addr_type type)
+get_address(struct socket_info *info, enum addr_type type, const char *name)
 {
 	struct sockaddr_in *sin;
-	uint16_t port;
+	int ring = get_cmd_opt_int("session-ring");
+	int port;
 
 	assert(info);
 	if_assert_failed return -1;
 
-	/* Each ring is bind to ELINKS_PORT + ring number. */
-	port = ELINKS_PORT + get_cmd_opt_int("session-ring");
-	if (port < IPPORT_USERRESERVED)
+	/* Each ring is bind to ELINKS_PORT + ring number, and its dump
+	 * server to ELINKS_DUMP_PORT - ring number, so that the ports of
+	 * the two never meet. */
+	if (ring < 0 || ring > 0xFFFF)
+		return -1;
+	if (strcmp(name, ELINKS_SOCK_NAME))
+		port = ELINKS_DUMP_PORT - ring;
+	else
+		port = ELINKS_PORT + ring;
+	if (port < IPPORT_USERRESERVED || port > 0xFFFF)
 		return -1; /* Just in case of... */
 
 	sin = mem_calloc(1, sizeof(*sin));
@@ -355,6 +370,28 @@ af_unix_connection(struct socket_info *info)
 	set_highpri();
 }
 
+/* Called when the dump server receives a connection. */
+static void
+af_unix_dump_connection(struct socket_info *info)
+{
+	int ns;
+	socklen_t l;
+
+	assert(info);
+	if_assert_failed return;
+
+	l = info->size;
+
+	memset(info->addr, 0, l);
+	ns = accept(info->fd, info->addr, &l);
+	if (ns < 0) {
+		report_af_unix_error("accept()", errno);
+		return;
+	}
+
+	dump_connection_handler(ns);
+}
+
 /* usleep() is not portable, so we use this replacement.
  * TODO: move it to somewhere. */
 void
@@ -372,28 +409,53 @@ elinks_usleep(unsigned long useconds)
 	select(0, &dummy1, &dummy2, &dummy3, &delay);
 }
 
-/* Listen on socket for internal ELinks communication.
+static void safe_close(int *fd) {
+	if (*fd == -1) return;
+	close(*fd);
+	*fd = -1;
+}
+
+/* Close the socket of @info and free its address. */
+static void
+done_socket_info(struct socket_info *info, int unlink_addr)
+{
+	/* We test for addr != NULL since
+	 * if it was not allocated then fd is not
+	 * initialized and we don't want to close
+	 * fd 0 ;). --Zas */
+	if (!info->addr) return;
+
+	safe_close(&info->fd);
+	if (unlink_addr) unlink_unix(info->addr);
+	mem_free(info->addr);
+	info->addr = NULL;
+}
+
+/* Listen on the socket @name for internal ELinks communication, passing
+ * accepted connections to @handler.
  * Returns -1 on error
  * or listened file descriptor on success. */
 static int
-bind_to_af_unix(void)
+bind_to_af_unix(const char *name, struct socket_info *listen_info,
+		struct socket_info *accept_info,
+		void (*handler)(struct socket_info *))
 {
 	mode_t saved_mask = umask(S_IXUSR | S_IRWXG | S_IRWXO);
 	int attempts = 0;
-	int pf = get_address(&s_info_listen, ADDR_IP_SERVER);
+	int pf = get_address(listen_info, ADDR_IP_SERVER, name);
 
 	if (pf == -1) goto free_and_error;
 
 	while (1) {
-		s_info_listen.fd = socket(pf, SOCK_STREAM, 0);
-		if (s_info_listen.fd == -1) {
+		listen_info->fd = socket(pf, SOCK_STREAM, 0);
+		if (listen_info->fd == -1) {
 			report_af_unix_error("socket()", errno);
 			goto free_and_error;
 		}
 
-		setsock_reuse_addr(s_info_listen.fd);
+		setsock_reuse_addr(listen_info->fd);
 
-		if (bind(s_info_listen.fd, s_info_listen.addr, s_info_listen.size) >= 0)
+		if (bind(listen_info->fd, listen_info->addr, listen_info->size) >= 0)
 			break;
 
 		if (errno != EADDRINUSE)
@@ -402,109 +464,92 @@ bind_to_af_unix(void)
 		++attempts;
 
 		if (attempts == MAX_BIND_TRIES)
-			unlink_unix(s_info_listen.addr);
+			unlink_unix(listen_info->addr);
 
 		if (attempts > MAX_BIND_TRIES)
 			goto free_and_error;
 
 		elinks_usleep(BIND_TRIES_DELAY * attempts);
-		close(s_info_listen.fd);
+		close(listen_info->fd);
 	}
 
 	/* Listen and accept. */
-	if (!alloc_address(&s_info_accept))
+	if (!alloc_address(accept_info))
 		goto free_and_error;
 
-	s_info_accept.fd = s_info_listen.fd;
+	accept_info->fd = listen_info->fd;
 
-	if (listen(s_info_listen.fd, LISTEN_BACKLOG)) {
+	if (listen(listen_info->fd, LISTEN_BACKLOG)) {
 		report_af_unix_error("listen()", errno);
 		goto free_and_error;
 	}
 
-	set_handlers(s_info_listen.fd, (void (*)(void *)) af_unix_connection,
-		     NULL, NULL, &s_info_accept);
+	set_handlers(listen_info->fd, (void (*)(void *)) handler,
+		     NULL, NULL, accept_info);
 
 	umask(saved_mask);
-	return s_info_listen.fd;
+	return listen_info->fd;
 
 free_and_error:
-	done_interlink();
+	if (listen_info == &s_info_listen) {
+		done_interlink();
+	} else {
+		done_socket_info(listen_info, 1);
+		done_socket_info(accept_info, 0);
+	}
 	umask(saved_mask);
 
 	return -1;
 }
 
-/* Connect to an listening socket for internal ELinks communication.
+/* Connect to the listening socket @name for internal ELinks communication,
+ * trying up to @tries times.
  * Returns -1 on error
  * or file descriptor on success. */
 static int
-connect_to_af_unix(void)
+connect_to_af_unix(const char *name, struct socket_info *info, int tries)
 {
 	int attempts = 0;
-	int pf = get_address(&s_info_connect, ADDR_IP_CLIENT);
+	int pf = get_address(info, ADDR_IP_CLIENT, name);
 
-	while (pf != -1 && attempts++ < MAX_CONNECT_TRIES) {
+	while (pf != -1 && attempts++ < tries) {
 		int saved_errno;
 
-		s_info_connect.fd = socket(pf, SOCK_STREAM, 0);
-		if (s_info_connect.fd == -1) {
+		info->fd = socket(pf, SOCK_STREAM, 0);
+		if (info->fd == -1) {
 			report_af_unix_error("socket()", errno);
 			break;
 		}
 
-		if (connect(s_info_connect.fd, s_info_connect.addr,
-			    s_info_connect.size) >= 0)
-				return s_info_connect.fd;
+		if (connect(info->fd, info->addr, info->size) >= 0)
+				return info->fd;
 
 		saved_errno = errno;
-		close(s_info_connect.fd);
+		close(info->fd);
 
 		if (saved_errno != ECONNREFUSED && saved_errno != ENOENT) {
 			report_af_unix_error("connect()", errno);
 			break;
 		}
 
-		elinks_usleep(CONNECT_TRIES_DELAY * attempts);
+		if (attempts < tries)
+			elinks_usleep(CONNECT_TRIES_DELAY * attempts);
 	}
 
-	mem_free_set(&s_info_connect.addr, NULL);
+	mem_free_set(&info->addr, NULL);
 	return -1;
 }
 
-static void safe_close(int *fd) {
-	if (*fd == -1) return;
-	close(*fd);
-	*fd = -1;
-}
-
 /* Free all allocated memory and close all descriptors if
  * needed. */
 void
 done_interlink(void)
 {
-	/* We test for addr != NULL since
-	 * if it was not allocated then fd is not
-	 * initialized and we don't want to close
-	 * fd 0 ;). --Zas */
-	if (s_info_listen.addr) {
-		safe_close(&s_info_listen.fd);
-		unlink_unix(s_info_listen.addr);
-		mem_free(s_info_listen.addr);
-		s_info_listen.addr = NULL;
-	}
-
-	if (s_info_connect.addr) {
-		safe_close(&s_info_connect.fd);
-		mem_free(s_info_connect.addr);
-		s_info_connect.addr = NULL;
-	}
-
-	if (s_info_accept.addr) {
-		safe_close(&s_info_accept.fd);
-		mem_free(s_info_accept.addr);
-		s_info_accept.addr = NULL;
-	}
+	done_socket_info(&s_info_listen, 1);
+	done_socket_info(&s_info_connect, 0);
+	done_socket_info(&s_info_accept, 0);
+	done_socket_info(&s_info_dump_listen, 1);
+	done_socket_info(&s_info_dump_accept, 0);
 }
 
 /* Initialize sockets for internal ELinks communication.
@@ -515,7 +560,8 @@ done_interlink(void)
 int
 init_interlink(void)
 {
-	int fd = connect_to_af_unix();
+	int fd = connect_to_af_unix(ELINKS_SOCK_NAME, &s_info_connect,
+				    MAX_CONNECT_TRIES);
 	int pid;
 
 	if (fd != -1 || remote_session_flags) return fd;
@@ -531,7 +577,9 @@ init_interlink(void)
 			int i;
 
 			for (i = 1; i <= (MAX_BIND_TRIES+2); ++i) {
-				fd = connect_to_af_unix();
+				fd = connect_to_af_unix(ELINKS_SOCK_NAME,
+							&s_info_connect,
+							MAX_CONNECT_TRIES);
 
 				if (fd != -1) return fd;
 				elinks_usleep(BIND_TRIES_DELAY * i);
@@ -540,10 +588,34 @@ init_interlink(void)
 		}
 		close_terminal_pipes();
 	}
-	bind_to_af_unix();
+	bind_to_af_unix(ELINKS_SOCK_NAME, &s_info_listen, &s_info_accept,
+			af_unix_connection);
 	return -1;
 }
 
+/* Listen on the dump server socket, passing each accepted connection to
+ * @handler. Returns the listening file descriptor, or -1 on error. */
+int
+init_dump_interlink(void (*handler)(int fd))
+{
+	dump_connection_handler = handler;
+
+	return bind_to_af_unix(ELINKS_DUMP_SOCK_NAME, &s_info_dump_listen,
+			       &s_info_dump_accept, af_unix_dump_connection);
+}
+
+/* Connect to a running dump server. The caller owns the returned file
+ * descriptor. Returns -1 if there is no dump server. */
+int
+connect_dump_interlink(void)
+{
+	struct socket_info info = { NULL, 0, -1 };
+	int fd = connect_to_af_unix(ELINKS_DUMP_SOCK_NAME, &info, 1);
+
+	mem_free_if(info.addr);
+	return fd;
+}
+
 
 #undef MAX_BIND_TRIES
 #undef BIND_TRIES_DELAY
@@ -8,9 +8,13 @@ extern "C" {
 #ifdef CONFIG_INTERLINK
 int init_interlink(void);
 void done_interlink(void);
+int init_dump_interlink(void (*handler)(int fd));
+int connect_dump_interlink(void);
 #else
 #define init_interlink() (-1)
 #define done_interlink()
+#define init_dump_interlink(handler) (-1)
+#define connect_dump_interlink() (-1)
 #endif
 
 #ifdef __cplusplus
@@ -182,11 +182,28 @@ init(void)
 		init_home();
 	}
 
+	/* A running dump server spares initializing all the modules. The
+	 * config file is still loaded, since the dump settings sent to the
+	 * server come from it. */
+	if (get_cmd_opt_bool("dump")
+	    && get_cmd_opt_bool("dump-use-server")
+	    && !list_empty(url_list)) {
+		parse_options_again();
+
+		if (dump_to_server(&url_list)) {
+			program.terminate = 1;
+			close_terminal_pipes();
+			free_string_list(&url_list);
+			return;
+		}
+	}
+
 	/* If there's no -no-connect, -dump or -source option, check if there's
 	 * no other ELinks running. If we found any, by-pass initialization of
 	 * non critical subsystems, open socket and act as a slave for it. */
 	if (get_cmd_opt_bool("no-connect")
 	    || get_cmd_opt_bool("dump")
+	    || get_cmd_opt_bool("dump-server")
 	    || get_cmd_opt_bool("source")
 	    || (fd = init_interlink()) == -1) {
 
@@ -195,7 +212,17 @@ init(void)
 		init_modules(builtin_modules);
 	}
 
-	if (get_cmd_opt_bool("dump")
+	if (get_cmd_opt_bool("dump-server")) {
+#ifdef CONFIG_ECMASCRIPT
+		get_opt_bool("ecmascript.enable", NULL) = 0;
+#endif
+		if (init_dump_server() == -1) {
+			usrerror(gettext("Unable to start the dump server."));
+			program.retval = RET_FATAL;
+			program.terminate = 1;
+		}
+
+	} else if (get_cmd_opt_bool("dump")
 	    || get_cmd_opt_bool("source")) {
 		/* Dump the URL list */
 #ifdef CONFIG_ECMASCRIPT
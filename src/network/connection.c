@@ -830,8 +830,10 @@ static void
 check_queue(void)
 {
 	struct connection *conn;
-	int max_conns_to_host = get_opt_int("connection.max_connections_to_host", NULL);
-	int max_conns = get_opt_int("connection.max_connections", NULL);
+	static struct option_handle max_conns_to_host_opt = INIT_OPTION_HANDLE("connection.max_connections_to_host");
+	static struct option_handle max_conns_opt = INIT_OPTION_HANDLE("connection.max_connections");
+	int max_conns_to_host = get_opt_int_handle(&max_conns_to_host_opt);
+	int max_conns = get_opt_int_handle(&max_conns_opt);
 
 again:
 	conn = connection_queue.next;
@@ -1033,6 +1035,59 @@ load_uri(struct uri *uri, struct uri *referrer, struct download *download,
 	return 0;
 }
 
+int
+load_uri_range(struct uri *uri, struct uri *referrer, struct download *download,
+	       enum connection_priority pri, off_t start, off_t end)
+{
+	struct cache_entry *cached;
+	struct connection *conn;
+	struct uri *proxy_uri, *proxied_uri;
+
+	assert(download && start > 0 && end > start);
+	if_assert_failed return -1;
+
+	download->conn = NULL;
+	download->cached = NULL;
+	download->pri = pri;
+	download->state = connection_state(S_OUT_OF_MEM);
+	download->prev_error = connection_state(0);
+
+	proxied_uri = get_proxied_uri(uri);
+	proxy_uri   = get_proxy_uri(uri, NULL);
+	cached = proxy_uri ? get_private_cache_entry(proxy_uri) : NULL;
+	conn = cached && proxied_uri
+	     ? init_connection(proxy_uri, proxied_uri, referrer, start,
+			       CACHE_MODE_NORMAL, pri)
+	     : NULL;
+
+	if (!conn) {
+		if (cached) delete_cache_entry(cached);
+		if (proxy_uri) done_uri(proxy_uri);
+		if (proxied_uri) done_uri(proxied_uri);
+		return -1;
+	}
+
+	/* Nobody else may attach to this connection, and cancelling the
+	 * download aborts it. */
+	conn->cached = cached;
+	conn->detached = 1;
+	conn->from = start;
+	conn->range_end = end;
+
+	download->progress = conn->progress;
+	download->conn = conn;
+	download->state = connection_state(S_OK);
+	add_to_list(conn->downloads, download);
+
+	add_to_queue(conn);
+	set_connection_state(conn, connection_state(S_WAIT));
+
+	check_queue_bugs();
+
+	register_check_queue();
+	return 0;
+}
+
 
 /* FIXME: one object in more connections */
 void
@@ -1120,9 +1175,9 @@ move_download(struct download *old, struct download *new_,
 
 
 /* This will remove 'pos' bytes from the start of the cache for the specified
- * connection, if the cached object is already too big. */
+ * connection, if the cached object is already too big or @always is set. */
 void
-detach_connection(struct download *download, off_t pos)
+detach_connection(struct download *download, off_t pos, int always)
 {
 	struct connection *conn = download->conn;
 
@@ -1138,9 +1193,10 @@ detach_connection(struct download *download, off_t pos)
 		total_len = (conn->est_length == -1) ? conn->from
 						     : conn->est_length;
 
-		if (total_len < (get_opt_long("document.cache.memory.size",
-		                              NULL)
-				 * MAX_CACHED_OBJECT_PERCENT / 100)) {
+		if (!always
+		    && total_len < (get_opt_long("document.cache.memory.size",
+						 NULL)
+				    * MAX_CACHED_OBJECT_PERCENT / 100)) {
 			/* This whole thing will fit to the memory anyway, so
 			 * there's no problem in detaching the connection. */
 			return;
@@ -1151,9 +1207,6 @@ detach_connection(struct download *download, off_t pos)
 		assertm(total_pri, "detaching free connection");
 		/* No recovery path should be necessary...? */
 
-		/* Pre-clean cache. */
-		shrink_format_cache(0);
-
 		if (total_pri != 1 || is_object_used(conn->cached)) {
 			/* We're too important, or someone uses our cache
 			 * entry. */
@@ -1165,6 +1218,10 @@ detach_connection(struct download *download, off_t pos)
 		/* We aren't valid cache entry anymore. */
 		conn->cached->valid = 0;
 		conn->detached = 1;
+
+		/* Clean the cache once, as the documents formatted from
+		 * the entry are out of date now. */
+		shrink_format_cache(0);
 	}
 
 	/* Strip the entry. */
@@ -44,6 +44,7 @@ struct connection {
 	off_t from;		/* Position for new data in the cache entry. */
 	off_t received;		/* The number of received bytes. */
 	off_t est_length;	/* Estimated number of bytes to transfer. */
+	off_t range_end;	/* Where to stop loading, if not at the end. */
 
 	enum stream_encoding content_encoding;
 	struct stream_encoded *stream;
@@ -106,7 +107,7 @@ void cancel_download(struct download *download, int interrupt);
 void move_download(struct download *old, struct download *new_,
 		     enum connection_priority newpri);
 
-void detach_connection(struct download *, off_t);
+void detach_connection(struct download *, off_t, int);
 void abort_all_connections(void);
 void abort_background_connections(void);
 
@@ -121,6 +122,12 @@ void shutdown_connection_stream(struct connection *conn);
 int load_uri(struct uri *uri, struct uri *referrer, struct download *download,
 	     enum connection_priority pri, enum cache_mode cache_mode, off_t start);
 
+/* Loads the bytes from @start up to @end of @uri over a new connection,
+ * into a cache entry of its own. Unlike load_uri() the callback is not
+ * called when this fails. Returns 0 on success and -1 on failure. */
+int load_uri_range(struct uri *uri, struct uri *referrer, struct download *download,
+		   enum connection_priority pri, off_t start, off_t end);
+
 int is_entry_used(struct cache_entry *cached);
 
 #ifdef __cplusplus
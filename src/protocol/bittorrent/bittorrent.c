@@ -150,6 +150,25 @@ static union option_info bittorrent_protocol_options[] = {
 		"\n"
 		"Set to 0 to have unlimited size.")),
 
+	INIT_OPT_INT("protocol.bittorrent", N_("Maximum number of open files"),
+		"max_open_files", 0, 1, INT_MAX, 16,
+		N_("The maximum number of files to keep open for reading and "
+		"writing pieces of a torrent.")),
+
+	INIT_OPT_BOOL("protocol.bittorrent", N_("Preallocate files"),
+		"preallocate", 0, 0,
+		N_("Whether to reserve disk space for the whole file when a "
+		"file of a torrent is created. This avoids fragmentation "
+		"but makes the files take up their full size right away.")),
+
+	INIT_OPT_INT("protocol.bittorrent", N_("Number of resume workers"),
+		"resume_workers", 0, 0, 64, 0,
+		N_("The number of processes to use for checking the hashes of "
+		"already downloaded pieces when resuming a download. Each "
+		"process checks a contiguous range of pieces.\n"
+		"\n"
+		"Set to 0 to use one process per online CPU.")),
+
 	/* ****************************************************************** */
 	/* Strategy options: */
 	/* ****************************************************************** */
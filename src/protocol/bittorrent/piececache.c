@@ -10,6 +10,9 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h> /* OS/2 needs this after sys/types.h */
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h> /* OS/2 needs this after sys/types.h */
 #endif
@@ -20,6 +23,7 @@
 #include "elinks.h"
 
 #include "cache/cache.h"
+#include "config/options.h"
 #include "main/select.h"
 #include "network/connection.h"
 #include "osdep/osdep.h"
@@ -34,6 +38,7 @@
 #include "util/error.h"
 #include "util/file.h"
 #include "util/lists.h"
+#include "util/math.h"
 #include "util/memory.h"
 #include "util/random.h"
 #include "util/string.h"
@@ -45,15 +50,124 @@
 /* Used as a 'not interesting' value for piece rarities. */
 #define BITTORRENT_PIECE_RARITY_UNDEF	USHRT_MAX
 
+/* Flag set in resume records for pieces which passed the hash check. */
+#define BITTORRENT_RESUME_VALID		0x80000000
+
+/* Maximum number of processes verifying pieces when resuming. */
+#define BITTORRENT_RESUME_MAX_WORKERS	64
+
+/* Number of resume records a worker writes at once. */
+#define BITTORRENT_RESUME_BATCH_SIZE	16
+
 /* A shorthand to reduce long lines. */
 #define find_local_bittorrent_peer_request(peer, request) \
 	get_bittorrent_peer_request(&(peer)->local, (request)->piece, \
 				    (request)->offset, (request)->length)
 
+/* Number of rarity bucket entries to look at when looking for the rarest
+ * piece. If the peer has none of them, any piece it has is picked. */
+#define BITTORRENT_RARITY_SCAN_LIMIT	256
+
+static inline int
+get_bittorrent_rarity_bucket(uint16_t rarity)
+{
+	return rarity < BITTORRENT_RARITY_BUCKETS
+		? rarity : BITTORRENT_RARITY_BUCKETS - 1;
+}
+
+static inline int
+randomize(size_t scale)
+{
+	double random = (double) rand() / RAND_MAX;
+	int index = random * (scale - 1);
+
+	return index;
+}
+
+/* Insert the piece into the bucket matching its rarity. To avoid always
+ * picking pieces in the same order the piece is randomly added to either the
+ * start or the end of the bucket. */
+static void
+link_bittorrent_rarity_bucket(struct bittorrent_piece_cache *cache,
+			      uint32_t piece)
+{
+	struct bittorrent_piece_cache_entry *entry = &cache->entries[piece];
+	uint32_t *bucket = &cache->rarity_buckets[get_bittorrent_rarity_bucket(entry->rarity)];
+	uint32_t first = *bucket;
+	uint32_t last;
+
+	entry->rarity_next = BITTORRENT_PIECE_UNDEF;
+
+	/* The previous link of the first piece points to the last piece. */
+	if (first == BITTORRENT_PIECE_UNDEF) {
+		entry->rarity_prev = piece;
+		*bucket = piece;
+		return;
+	}
+
+	last = cache->entries[first].rarity_prev;
+	entry->rarity_prev = last;
+	cache->entries[first].rarity_prev = piece;
+
+	if (rand() & 1) {
+		entry->rarity_next = first;
+		*bucket = piece;
+	} else {
+		cache->entries[last].rarity_next = piece;
+	}
+}
+
+static void
+unlink_bittorrent_rarity_bucket(struct bittorrent_piece_cache *cache,
+				uint32_t piece)
+{
+	struct bittorrent_piece_cache_entry *entry = &cache->entries[piece];
+	uint32_t *bucket = &cache->rarity_buckets[get_bittorrent_rarity_bucket(entry->rarity)];
+
+	if (*bucket == piece) {
+		*bucket = entry->rarity_next;
+		if (*bucket != BITTORRENT_PIECE_UNDEF)
+			cache->entries[*bucket].rarity_prev = entry->rarity_prev;
+
+	} else {
+		cache->entries[entry->rarity_prev].rarity_next = entry->rarity_next;
+		if (entry->rarity_next != BITTORRENT_PIECE_UNDEF)
+			cache->entries[entry->rarity_next].rarity_prev = entry->rarity_prev;
+		else
+			cache->entries[*bucket].rarity_prev = entry->rarity_prev;
+	}
+
+	entry->rarity_next = entry->rarity_prev = BITTORRENT_PIECE_UNDEF;
+}
+
+/* Change the rarity of a piece keeping the rarity buckets in sync. */
+static inline void
+set_bittorrent_piece_cache_rarity(struct bittorrent_piece_cache *cache,
+				  uint32_t piece, uint16_t rarity)
+{
+	struct bittorrent_piece_cache_entry *entry = &cache->entries[piece];
+	int moved = entry->remaining
+		    && get_bittorrent_rarity_bucket(entry->rarity)
+		       != get_bittorrent_rarity_bucket(rarity);
+
+	if (moved)
+		unlink_bittorrent_rarity_bucket(cache, piece);
+
+	entry->rarity = rarity;
+
+	if (moved)
+		link_bittorrent_rarity_bucket(cache, piece);
+}
+
 static inline void
 set_bittorrent_piece_cache_remaining(struct bittorrent_piece_cache *cache,
 				     uint32_t piece, int remaining)
 {
+	if (!cache->entries[piece].remaining && remaining > 0)
+		link_bittorrent_rarity_bucket(cache, piece);
+	else if (cache->entries[piece].remaining && remaining <= 0)
+		unlink_bittorrent_rarity_bucket(cache, piece);
+
 	cache->entries[piece].remaining = remaining > 0 ? 1 : 0;
 	cache->remaining_pieces += remaining;
 	cache->loading_pieces   += -remaining;
@@ -63,6 +177,9 @@ static inline void
 set_bittorrent_piece_cache_completed(struct bittorrent_piece_cache *cache,
 				     uint32_t piece)
 {
+	if (cache->entries[piece].remaining)
+		unlink_bittorrent_rarity_bucket(cache, piece);
+
 	cache->entries[piece].completed = 1;
 	cache->entries[piece].remaining = 0;
 	cache->loading_pieces--;
@@ -135,15 +252,6 @@ find_bittorrent_free_list_peer_request(struct bittorrent_piece_cache *cache,
 	return NULL;
 }
 
-static inline int
-randomize(size_t scale)
-{
-	double random = (double) rand() / RAND_MAX;
-	int index = random * (scale - 1);
-
-	return index;
-}
-
 /* Pseudo-randomly select a piece that is available from the peer. */
 static uint32_t
 find_random_in_bittorrent_piece_cache(struct bittorrent_piece_cache *cache,
@@ -235,42 +343,65 @@ find_rarest_in_bittorrent_piece_cache(struct bittorrent_piece_cache *cache,
 	};
 	int places = sizeof_array(pieces);
 	uint16_t piece_rarity = BITTORRENT_PIECE_RARITY_UNDEF;
-	uint32_t piece;
+	int bucket, found = 0, visited = 0;
 
 	assert(peer->bitfield->bitsize == peer->bittorrent->meta.pieces);
 
 	seed_rand_once();
 
-	/* Try to randomize the piece picking using the strategy from the random
-	 * piece selection. */
-	foreachback_bitfield_set (piece, peer->bitfield) {
-		struct bittorrent_piece_cache_entry *entry;
-		int pos, skip = sizeof_array(pieces) / places;
+	/* Search the rarity buckets starting with the rarest pieces. The first
+	 * bucket holds pieces which no peer has so it is skipped. All buckets
+	 * except the last one only hold pieces with the same rarity. */
+	for (bucket = 1;
+	     bucket < BITTORRENT_RARITY_BUCKETS && !found
+	     && visited < BITTORRENT_RARITY_SCAN_LIMIT;
+	     bucket++) {
+		uint32_t piece = cache->rarity_buckets[bucket];
 
-		entry = &cache->entries[piece];
+		/* Try to randomize the piece picking using the strategy from
+		 * the random piece selection. */
+		for (; piece != BITTORRENT_PIECE_UNDEF
+		       && visited < BITTORRENT_RARITY_SCAN_LIMIT;
+		     piece = cache->entries[piece].rarity_next) {
+			struct bittorrent_piece_cache_entry *entry;
+			int pos, skip;
 
-		assertm(entry->rarity, "Piece cache out of sync");
+			entry = &cache->entries[piece];
 
-		if (!entry->remaining || entry->rarity > piece_rarity)
-			continue;
+			assertm(entry->rarity && entry->remaining,
+				"Piece cache out of sync");
 
-		if (entry->rarity < piece_rarity) {
-			places = sizeof_array(pieces);
-			piece_rarity = entry->rarity;
+			visited++;
 
-		} else if (places < 2) {
-			pieces[randomize(sizeof_array(pieces))] = piece;
-			continue;
-		}
+			if (!test_bitfield_bit(peer->bitfield, piece)
+			    || entry->rarity > piece_rarity)
+				continue;
+
+			found++;
+
+			if (entry->rarity < piece_rarity) {
+				places = sizeof_array(pieces);
+				piece_rarity = entry->rarity;
+
+			} else if (places < 2) {
+				pieces[randomize(sizeof_array(pieces))] = piece;
+				continue;
+			}
 
-		skip = sizeof_array(pieces) / places;
+			skip = sizeof_array(pieces) / places;
 
-		for (pos = 0; pos < sizeof_array(pieces); pos += skip)
-			pieces[pos] = piece;
+			for (pos = 0; pos < sizeof_array(pieces); pos += skip)
+				pieces[pos] = piece;
 
-		places /= 2;
+			places /= 2;
+		}
 	}
 
+	/* Rather than walking all the buckets for the few pieces the peer
+	 * has, fall back to its bitfield. */
+	if (!found && visited >= BITTORRENT_RARITY_SCAN_LIMIT)
+		return find_random_in_bittorrent_piece_cache(cache, peer);
+
 	return pieces[randomize(sizeof_array(pieces))];
 }
 
@@ -541,7 +672,8 @@ update_bittorrent_piece_cache(struct bittorrent_peer_connection *peer,
 	    && !cache->entries[piece].rarity)
 		cache->unavailable_pieces--;
 
-	cache->entries[piece].rarity++;
+	set_bittorrent_piece_cache_rarity(cache, piece,
+					  cache->entries[piece].rarity + 1);
 	assertm(cache->entries[piece].rarity <= list_size(&peer->bittorrent->peers),
 		"Piece rarity overflow");
 }
@@ -567,7 +699,8 @@ remove_bittorrent_peer_from_piece_cache(struct bittorrent_peer_connection *peer)
 	assert(peer->bitfield);
 
 	foreach_bitfield_set (piece, peer->bitfield) {
-		cache->entries[piece].rarity--;
+		set_bittorrent_piece_cache_rarity(cache, piece,
+						  cache->entries[piece].rarity - 1);
 		assertm(cache->entries[piece].rarity <= list_size(&peer->bittorrent->peers),
 			"Piece rarity underflow");
 
@@ -646,17 +779,61 @@ enum bittorrent_translation {
 	BITTORRENT_SEEK,
 };
 
+static void
+close_bittorrent_file(struct bittorrent_piece_cache *cache,
+		      struct bittorrent_file_handle *handle)
+{
+	del_from_list(handle);
+	close(handle->fd);
+	mem_free(handle);
+	cache->open_files_count--;
+}
+
+static void
+close_bittorrent_files(struct bittorrent_piece_cache *cache)
+{
+	while (!list_empty(cache->open_files))
+		close_bittorrent_file(cache, cache->open_files.next);
+}
+
+/* Get a descriptor for the file, possibly creating the file and parent
+ * directories. The descriptor is owned by the cache and must not be closed. */
 static int
-open_bittorrent_file(struct bittorrent_meta *meta, struct bittorrent_file *file,
-		     enum bittorrent_translation trans, off_t offset)
+open_bittorrent_file(struct bittorrent_meta *meta,
+		     struct bittorrent_piece_cache *cache,
+		     struct bittorrent_file *file,
+		     enum bittorrent_translation trans)
 {
-	char *name = get_bittorrent_file_name(meta, file);
-	off_t seek_result;
+	struct bittorrent_file_handle *handle;
+	int max_open_files = get_opt_int("protocol.bittorrent.max_open_files", NULL);
+	int writable = (trans == BITTORRENT_WRITE);
+	int flags = (writable ? O_RDWR : O_RDONLY);
+	int created = 0;
+	char *name;
 	int fd;
-	int flags = (trans == BITTORRENT_WRITE ? O_WRONLY : O_RDONLY);
 
 	assert(trans != BITTORRENT_SEEK);
 
+#ifdef O_CLOEXEC
+	/* The descriptors stay open, but not in the programs we start. */
+	flags |= O_CLOEXEC;
+#endif
+
+	foreach (handle, cache->open_files) {
+		if (handle->file != file)
+			continue;
+
+		/* Reopen files which are only open for reading. */
+		if (writable && !handle->writable) {
+			close_bittorrent_file(cache, handle);
+			break;
+		}
+
+		move_to_top_of_list(cache->open_files, handle);
+		return handle->fd;
+	}
+
+	name = get_bittorrent_file_name(meta, file);
 	if (!name) return -1;
 
 	fd = open(name, flags, S_IRUSR | S_IWUSR);
@@ -664,33 +841,71 @@ open_bittorrent_file(struct bittorrent_meta *meta, struct bittorrent_file *file,
 		/* 99% of the time the file will already exist so special case
 		 * the directory and file creation. */
 		if (errno == ENOENT
-		    && trans == BITTORRENT_WRITE
-		    && create_bittorrent_path(name) == BITTORRENT_STATE_OK)
+		    && writable
+		    && create_bittorrent_path(name) == BITTORRENT_STATE_OK) {
 			fd = open(name, flags | O_CREAT, S_IRUSR | S_IWUSR);
+			created = (fd != -1);
+		}
 	}
 
 	mem_free(name);
 
 	if (fd == -1) return -1;
 
-	if (trans == BITTORRENT_READ) {
-		struct stat stat;
-
-		if (fstat(fd, &stat) < -1 || stat.st_size < offset) {
-			close(fd);
-			return -1;
-		}
-	}
+#ifdef HAVE_POSIX_FALLOCATE
+	/* Reserve space for the whole file up front to avoid fragmenting it
+	 * when pieces are written out of order. Failing is not fatal. */
+	if (created && get_opt_bool("protocol.bittorrent.preallocate", NULL))
+		posix_fallocate(fd, 0, file->length);
+#endif
 
-	seek_result = lseek(fd, offset, SEEK_SET);
-	if (seek_result == (off_t) -1 || seek_result != offset) {
+	handle = mem_calloc(1, sizeof(*handle));
+	if (!handle) {
 		close(fd);
 		return -1;
 	}
 
+	handle->file	 = file;
+	handle->fd	 = fd;
+	handle->writable = writable;
+
+	add_to_list(cache->open_files, handle);
+	cache->open_files_count++;
+
+	/* Close the least recently used files. */
+	while (cache->open_files_count > max_open_files)
+		close_bittorrent_file(cache, cache->open_files.prev);
+
 	return fd;
 }
 
+/* Read or write @length bytes of @data at @offset in the file. */
+static ssize_t
+transfer_bittorrent_file_data(int fd, enum bittorrent_translation trans,
+			      char *data, uint32_t length, off_t offset)
+{
+#if defined(HAVE_PREAD) && defined(HAVE_PWRITE)
+	do {
+		ssize_t result = (trans == BITTORRENT_READ)
+			       ? pread(fd, data, length, offset)
+			       : pwrite(fd, data, length, offset);
+
+		if (result == -1 && errno == EINTR) continue;
+		return result;
+	} while (1);
+#else
+	off_t seek_result = lseek(fd, offset, SEEK_SET);
+
+	if (seek_result == (off_t) -1 || seek_result != offset)
+		return -1;
+
+	if (trans == BITTORRENT_READ)
+		return safe_read(fd, data, length);
+
+	return safe_write(fd, data, length);
+#endif
+}
+
 static enum bittorrent_state
 bittorrent_file_piece_translation(struct bittorrent_meta *meta,
 				  struct bittorrent_piece_cache *cache,
@@ -777,9 +992,9 @@ bittorrent_file_piece_translation(struct bittorrent_meta *meta,
 			assert(entry->completed && trans == BITTORRENT_READ);
 		}
 
-		/* Open at the desired offset and possibly create the file and
-		 * parent directories. */
-		fd = open_bittorrent_file(meta, file, trans, file_offset);
+		/* Get the file and possibly create it and parent
+		 * directories. */
+		fd = open_bittorrent_file(meta, cache, file, trans);
 		if (fd == -1) {
 			/* Try to gracefully handle bogus paths; empty file
 			 * names and directory names. */
@@ -800,21 +1015,29 @@ bittorrent_file_piece_translation(struct bittorrent_meta *meta,
 
 		assert(entry->data);
 
-		data = &entry->data[piece_offset];
-
-		/* Do it! ;-) */
+		/* A file too short for the piece has to be completed by
+		 * downloading the piece again. */
 		if (trans == BITTORRENT_READ) {
-			length = safe_read(fd, data, data_length);
-		} else {
-			length = safe_write(fd, data, data_length);
+			struct stat st;
+
+			if (fstat(fd, &st)
+			    || st.st_size < file_offset + (off_t) data_length) {
+				state = BITTORRENT_STATE_FILE_MISSING;
+				break;
+			}
 		}
 
-		/* Cleanup. */
-		close(fd);
+		data = &entry->data[piece_offset];
+
+		/* Do it! ;-) */
+		length = transfer_bittorrent_file_data(fd, trans, data,
+						       data_length, file_offset);
 
 		/* Check if the operation failed. */
-		if (length != data_length)
-			return BITTORRENT_STATE_ERROR;
+		if (length != data_length) {
+			state = BITTORRENT_STATE_ERROR;
+			break;
+		}
 
 		/* Prepare the next iteration. */
 		piece_offset   += data_length;
@@ -822,7 +1045,7 @@ bittorrent_file_piece_translation(struct bittorrent_meta *meta,
 	}
 
 	if (state != BITTORRENT_STATE_OK || piece_offset != piece_length) {
-		if (piece_offset != piece_length)
+		if (state == BITTORRENT_STATE_OK)
 			state = BITTORRENT_STATE_ERROR;
 
 		assert(trans != BITTORRENT_SEEK);
@@ -1072,50 +1295,39 @@ end_bittorrent_resume(struct bittorrent_connection *bittorrent)
 	bittorrent_resume_callback(bittorrent);
 }
 
+/* Verify the pieces in the range [@from, @to) and report the result for each
+ * of them to the resume pipe. Results are written in small batches of records
+ * which fit inside PIPE_BUF, so several workers can share the pipe without
+ * their records getting interleaved. */
 static void
-bittorrent_resume_writer(void *data, int fd)
+verify_bittorrent_pieces(struct bittorrent_meta *meta, uint32_t from,
+			 uint32_t to, int fd)
 {
 	struct bittorrent_piece_cache cache;
-	struct bittorrent_meta meta;
-	struct bittorrent_const_string metafile;
+	uint32_t records[BITTORRENT_RESUME_BATCH_SIZE];
+	int count = 0;
 	uint32_t piece;
 
-	memcpy(&metafile.length, data, sizeof(metafile.length));
-	metafile.source = (const char *) data + sizeof(metafile.length);
-
-	if (parse_bittorrent_metafile(&meta, &metafile) != BITTORRENT_STATE_OK) {
-		done_bittorrent_meta(&meta);
-		return;
-	}
-
 	memset(&cache, 0, sizeof(cache));
 	init_list(cache.queue);
+	init_list(cache.open_files);
 
-	if (set_blocking_fd(fd) < 0) {
-		done_bittorrent_meta(&meta);
-		return;
-	}
-
-	for (piece = 0; piece < meta.pieces; piece++){
+	for (piece = from; piece < to; piece++) {
 		struct bittorrent_piece_cache_entry entry;
 		enum bittorrent_state state;
 		uint32_t length;
-		char complete;
-		int written;
+		uint32_t record = piece;
 
-		length = get_bittorrent_piece_length(&meta, piece);
+		length = get_bittorrent_piece_length(meta, piece);
 		memset(&entry, 0, sizeof(entry));
 
 		/* Attempt to read this piece from cache. This is used to resume
 		 * a download */
-		state = bittorrent_file_piece_translation(&meta, &cache, &entry,
+		state = bittorrent_file_piece_translation(meta, &cache, &entry,
 							  piece, BITTORRENT_READ);
 		if (state == BITTORRENT_STATE_OK
-		    && bittorrent_piece_is_valid(&meta, piece, entry.data, length)) {
-			complete = 1;
-		} else {
-			complete = 0;
-		}
+		    && bittorrent_piece_is_valid(meta, piece, entry.data, length))
+			record |= BITTORRENT_RESUME_VALID;
 
 		if (entry.data) {
 			if (state == BITTORRENT_STATE_OK)
@@ -1123,9 +1335,76 @@ bittorrent_resume_writer(void *data, int fd)
 			mem_mmap_free(entry.data, length);
 		}
 
-		written = safe_write(fd, &complete, 1);
-		if (written < 0)
+		records[count++] = record;
+		if (count < sizeof_array(records) && piece + 1 < to)
+			continue;
+
+		if (safe_write(fd, records, count * sizeof(*records)) < 0)
+			break;
+		count = 0;
+	}
+
+	close_bittorrent_files(&cache);
+}
+
+static void
+bittorrent_resume_writer(void *data, int fd)
+{
+	pid_t workers[BITTORRENT_RESUME_MAX_WORKERS];
+	struct bittorrent_meta meta;
+	struct bittorrent_const_string metafile;
+	uint32_t range, from;
+	int workers_count, worker, forked = 0;
+
+	memcpy(&workers_count, data, sizeof(workers_count));
+	data = (char *) data + sizeof(workers_count);
+	memcpy(&metafile.length, data, sizeof(metafile.length));
+	metafile.source = (const char *) data + sizeof(metafile.length);
+
+	if (parse_bittorrent_metafile(&meta, &metafile) != BITTORRENT_STATE_OK) {
+		done_bittorrent_meta(&meta);
+		return;
+	}
+
+	if (set_blocking_fd(fd) < 0 || !meta.pieces) {
+		done_bittorrent_meta(&meta);
+		return;
+	}
+
+	/* Split the pieces into one contiguous range per worker so that each
+	 * worker reads the files sequentially. The first range is handled by
+	 * this process. */
+	int_bounds(&workers_count, 1, BITTORRENT_RESUME_MAX_WORKERS);
+	if (workers_count > meta.pieces)
+		workers_count = meta.pieces;
+
+	range = (meta.pieces + workers_count - 1) / workers_count;
+	from = range;
+
+	for (worker = 1; worker < workers_count && from < meta.pieces; worker++) {
+		uint32_t to = from + range < meta.pieces ? from + range : meta.pieces;
+		pid_t pid = fork();
+
+		if (!pid) {
+			verify_bittorrent_pieces(&meta, from, to, fd);
+			_exit(0);
+		}
+
+		/* Verify the rest in this process if no more workers can be
+		 * started. */
+		if (pid == -1)
 			break;
+
+		workers[forked++] = pid;
+		from = to;
+	}
+
+	verify_bittorrent_pieces(&meta, 0, range, fd);
+	if (from < meta.pieces)
+		verify_bittorrent_pieces(&meta, from, meta.pieces, fd);
+
+	for (worker = 0; worker < forked; worker++) {
+		while (waitpid(workers[worker], NULL, 0) < 0 && errno == EINTR);
 	}
 
 	done_bittorrent_meta(&meta);
@@ -1135,29 +1414,37 @@ static void
 bittorrent_resume_reader(struct bittorrent_connection *bittorrent)
 {
 	struct bittorrent_piece_cache *cache = bittorrent->cache;
-	char completed[MAX_STR_LEN];
+	char buffer[MAX_STR_LEN];
 	ssize_t size, pos;
 
 	set_connection_timeout(bittorrent->conn);
 
-	size = safe_read(cache->resume_fd, completed, sizeof(completed));
+	/* Records may be split across reads so start with any leftover bytes
+	 * from the previous read. */
+	memcpy(buffer, cache->resume_record, cache->resume_record_length);
+	size = safe_read(cache->resume_fd, buffer + cache->resume_record_length,
+			 sizeof(buffer) - cache->resume_record_length);
 	if (size <= 0) {
 		end_bittorrent_resume(bittorrent);
 		return;
 	}
 
-	for (pos = 0; pos < size; pos++) {
-		uint32_t piece = cache->resume_pos++;
+	size += cache->resume_record_length;
+
+	for (pos = 0; pos + sizeof(uint32_t) <= size; pos += sizeof(uint32_t)) {
+		uint32_t record, piece;
 		uint32_t length;
 
-		if (piece >= bittorrent->meta.pieces) {
+		memcpy(&record, &buffer[pos], sizeof(record));
+		piece = record & ~BITTORRENT_RESUME_VALID;
+
+		if (cache->resume_pos++ >= bittorrent->meta.pieces
+		    || piece >= bittorrent->meta.pieces) {
 			end_bittorrent_resume(bittorrent);
 			return;
 		}
 
-		assert(piece < bittorrent->meta.pieces);
-
-		if (!completed[pos])
+		if (!(record & BITTORRENT_RESUME_VALID))
 			continue;
 
 		length = get_bittorrent_piece_length(&bittorrent->meta, piece);
@@ -1168,6 +1455,23 @@ bittorrent_resume_reader(struct bittorrent_connection *bittorrent)
 		bittorrent->left -= length;
 		bittorrent->conn->from += length;
 	}
+
+	cache->resume_record_length = size - pos;
+	memcpy(cache->resume_record, &buffer[pos], cache->resume_record_length);
+}
+
+/* Get the number of processes to use for verifying pieces when resuming. */
+static int
+get_bittorrent_resume_workers(void)
+{
+	int workers = get_opt_int("protocol.bittorrent.resume_workers", NULL);
+
+#ifdef _SC_NPROCESSORS_ONLN
+	if (!workers)
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+	return workers > 0 ? workers : 1;
 }
 
 static void
@@ -1176,11 +1480,15 @@ start_bittorrent_resume(struct bittorrent_connection *bittorrent,
 {
 	struct bittorrent_piece_cache *cache = bittorrent->cache;
 	struct string info;
+	int workers;
 
 	assert(cache && cache->resume_fd == -1);
 
 	if (!init_string(&info)) return;
 
+	workers = get_bittorrent_resume_workers();
+
+	add_bytes_to_string(&info, (void *) &workers, sizeof(workers));
 	add_bytes_to_string(&info, (void *) &meta->length, sizeof(meta->length));
 	add_bytes_to_string(&info, meta->source, meta->length);
 
@@ -1252,6 +1560,7 @@ init_bittorrent_piece_cache(struct bittorrent_connection *bittorrent,
 	uint32_t pieces = bittorrent->meta.pieces;
 	size_t cache_entry_size = sizeof(*cache->entries) * pieces;
 	uint32_t piece;
+	int bucket;
 
 	cache = mem_calloc(1, sizeof(*cache) + cache_entry_size);
 	if (!cache) return BITTORRENT_STATE_OUT_OF_MEM;
@@ -1266,6 +1575,10 @@ init_bittorrent_piece_cache(struct bittorrent_connection *bittorrent,
 
 	init_list(cache->queue);
 	init_list(cache->free_list);
+	init_list(cache->open_files);
+
+	for (bucket = 0; bucket < BITTORRENT_RARITY_BUCKETS; bucket++)
+		cache->rarity_buckets[bucket] = BITTORRENT_PIECE_UNDEF;
 
 	bittorrent->cache = cache;
 
@@ -1316,6 +1629,7 @@ done_bittorrent_piece_cache(struct bittorrent_connection *bittorrent)
 	uint32_t piece;
 
 	done_bittorrent_resume(cache);
+	close_bittorrent_files(cache);
 
 	for (piece = 0; piece < bittorrent->meta.pieces; piece++) {
 		struct bittorrent_piece_cache_entry *entry;
@@ -11,6 +11,10 @@ extern "C" {
 
 struct bitfield;
 
+/** Number of piece rarity buckets. Pieces with a rarity of
+ * ::BITTORRENT_RARITY_BUCKETS - 1 or more all share the last bucket. */
+#define BITTORRENT_RARITY_BUCKETS	64
+
 struct bittorrent_piece_cache_entry {
 	LIST_HEAD(struct bittorrent_piece_cache_entry);
 
@@ -28,6 +32,10 @@ struct bittorrent_piece_cache_entry {
 	unsigned int locked:1;		/**< Edge piece from partial downloads. */
 	unsigned int selected:1;	/**< Piece is part of partial download. */
 
+	/** Links to the next and previous piece in the rarity bucket of this
+	 * piece. Only remaining pieces are kept in the buckets. */
+	uint32_t rarity_next, rarity_prev;
+
 	/** A bitfield of the blocks which remains to be downloaded for this
 	 * piece. May be NULL if downloading is not in progress. */
 	struct bitfield *blocks;
@@ -39,6 +47,17 @@ struct bittorrent_piece_cache_entry {
 	char *data;
 };
 
+/** An open file of the torrent. Files are kept open to avoid reopening them
+ * for each piece that is read or written. */
+struct bittorrent_file_handle {
+	LIST_HEAD(struct bittorrent_file_handle);
+
+	struct bittorrent_file *file;
+	int fd;
+
+	unsigned int writable:1;	/**< Opened for writing? */
+};
+
 struct bittorrent_piece_cache {
 	/* The following is mostly maintained for making it easy to display in
 	 * dialogs. */
@@ -57,7 +76,11 @@ struct bittorrent_piece_cache {
 
 	/** The pipe descripter used for communicating with the resume thread. */
 	int resume_fd;
+	/** Number of resume records received. */
 	uint32_t resume_pos;
+	/** Partial resume record left over from the previous read. */
+	unsigned char resume_record[sizeof(uint32_t)];
+	unsigned int resume_record_length;
 
 	/** A bitfield of the available pieces. */
 	struct bitfield *bitfield;
@@ -67,6 +90,10 @@ struct bittorrent_piece_cache {
 	 * entries are sorted in a LRU-manner. */
 	LIST_OF(struct bittorrent_piece_cache_entry) queue;
 
+	/** The files which are currently open sorted in a LRU-manner. */
+	LIST_OF(struct bittorrent_file_handle) open_files;
+	unsigned int open_files_count;
+
 	/** Remaining pieces are tracked using the remaining_blocks member of the
 	 * piece cache entry and a free list of piece blocks to be requested.
 	 * Requests are taken from the free list every time a peer queries which
@@ -90,6 +117,13 @@ struct bittorrent_piece_cache {
 	 * the cloned flag is set when receiving a block then the peer-list is
 	 * searched and requests for the same piece is canceled. */
 	LIST_OF(struct bittorrent_piece_request) free_list;
+
+	/** Remaining pieces grouped by rarity to make it cheap to find the
+	 * rarest pieces. Each bucket holds the index of the first piece in a
+	 * list linked through the rarity_next and rarity_prev members of the
+	 * cache entries. */
+	uint32_t rarity_buckets[BITTORRENT_RARITY_BUCKETS];
+
 	struct bittorrent_piece_cache_entry entries[1];
 };
 
@@ -24,6 +24,7 @@
 #include "encoding/encoding.h"
 #include "intl/libintl.h"
 #include "main/module.h"
+#include "main/select.h"
 #include "network/connection.h"
 #include "network/socket.h"
 #include "osdep/osdep.h"
@@ -49,6 +50,18 @@ static union option_info file_options[] = {
 		"Note this can be dangerous; reading /dev/urandom or "
 		"/dev/zero can ruin your day!")),
 
+	INIT_OPT_BOOL("protocol.file", N_("Decode files in the background"),
+		"background_decoding", 0, 1,
+		N_("Whether to decompress encoded files (like 'file.gz') "
+		"in a separate process, so that ELinks stays responsive "
+		"and shows the document as it is being decoded.")),
+
+	INIT_OPT_BOOL("protocol.file", N_("Map files into memory"),
+		"mmap", 0, 1,
+		N_("Whether to map uncompressed regular files into memory "
+		"instead of reading a copy of them. The cached copy is "
+		"dropped once the file is modified.")),
+
 	INIT_OPT_BOOL("protocol.file", N_("Show hidden files in directory listing"),
 		"show_hidden_files", 0, 1,
 		N_("When set to false, files with name starting with a dot "
@@ -235,6 +248,219 @@ read_from_stdin(struct connection *conn)
 			check_if_closed);
 }
 
+/* Maps the regular, uncompressed file @name as the data of the cache entry
+ * of @connection. Returns 0 if the file should be read instead. */
+static int
+map_local_file(struct connection *connection, struct string *name)
+{
+	struct stat st;
+	int fd, mapped = 0;
+
+	if (!get_opt_bool("protocol.file.mmap", NULL)
+	    || guess_encoding(name->source) != ENCODING_NONE)
+		return 0;
+
+	fd = open(name->source, O_RDONLY | O_NOCTTY);
+	if (fd == -1) return 0;
+
+	if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+		connection->cached = get_cache_entry(connection->uri);
+		if (connection->cached
+		    && !add_file_fragment(connection->cached, fd, st.st_size,
+					  st.st_mtime)) {
+			connection->from = st.st_size;
+			mapped = 1;
+		}
+	}
+
+	if (!mapped) close(fd);
+	return mapped;
+}
+
+/* Encoded files are decoded by a background process that writes the data
+ * to a pipe in records, each starting with an int holding the number of
+ * data bytes following it. The last record has no data and is 0 if the
+ * whole file was decoded, or -1 on errors. */
+
+#define DECODED_FILE_BUFFER_SIZE 65536
+
+struct decoded_file_info {
+	int fd;
+
+	/* The data bytes of the current record still to be read. */
+	int remaining;
+
+	/* The header of the next record, which may come in pieces. */
+	int header;
+	int header_length;
+};
+
+static int
+write_decoded_record(int fd, char *record, int length)
+{
+	while (length > 0) {
+		int written = safe_write(fd, record, length);
+
+		if (written <= 0) return 0;
+		record += written;
+		length -= written;
+	}
+
+	return 1;
+}
+
+static void
+decoded_file_writer(void *data, int fd)
+{
+	static char record[sizeof(int) + DECODED_FILE_BUFFER_SIZE];
+	struct stream_encoded *stream;
+	struct string filename;
+	int readsize, length;
+
+	if (set_blocking_fd(fd) < 0) return;
+
+	if (!init_string(&filename)) return;
+	if (!add_to_string(&filename, (char *) data)
+	    || !is_in_state(open_encoded_file(&filename, &stream, &readsize), S_OK)) {
+		length = -1;
+		memcpy(record, &length, sizeof(length));
+		write_decoded_record(fd, record, sizeof(length));
+		done_string(&filename);
+		return;
+	}
+
+	do {
+		length = read_encoded(stream, record + sizeof(length),
+				      DECODED_FILE_BUFFER_SIZE);
+		memcpy(record, &length, sizeof(length));
+		if (!write_decoded_record(fd, record, sizeof(length) + int_max(length, 0)))
+			break;
+	} while (length > 0);
+
+	close_encoded(stream);
+	done_string(&filename);
+}
+
+static void
+done_decoded_file(struct connection *connection)
+{
+	struct decoded_file_info *info = connection->info;
+
+	clear_handlers(info->fd);
+	close(info->fd);
+}
+
+static void
+read_decoded_file(struct connection *connection)
+{
+	struct decoded_file_info *info = connection->info;
+	char buffer[DECODED_FILE_BUFFER_SIZE];
+	ssize_t size = safe_read(info->fd, buffer, sizeof(buffer));
+	ssize_t pos = 0;
+
+	if (size < 0 && errno == EAGAIN) return;
+	if (size <= 0) {
+		/* The decoder died before sending the last record. */
+		abort_connection(connection, connection_state(S_ENCODE_ERROR));
+		return;
+	}
+
+	set_connection_timeout(connection);
+	connection->received += size;
+
+	while (pos < size) {
+		int length;
+
+		if (info->remaining) {
+			length = int_min(info->remaining, size - pos);
+			add_fragment(connection->cached, connection->from,
+				     buffer + pos, length);
+			connection->from += length;
+			info->remaining -= length;
+			pos += length;
+			continue;
+		}
+
+		length = int_min(sizeof(info->header) - info->header_length,
+				 size - pos);
+		memcpy((char *) &info->header + info->header_length,
+		       buffer + pos, length);
+		info->header_length += length;
+		pos += length;
+
+		if (info->header_length < sizeof(info->header))
+			break;
+
+		info->header_length = 0;
+		if (info->header > 0) {
+			info->remaining = info->header;
+			continue;
+		}
+
+		if (info->header < 0) {
+			abort_connection(connection, connection_state(S_ENCODE_ERROR));
+		} else {
+			normalize_cache_entry(connection->cached, connection->from);
+			abort_connection(connection, connection_state(S_OK));
+		}
+		return;
+	}
+
+	set_connection_state(connection, connection_state(S_TRANS));
+}
+
+static void
+error_decoded_file(struct connection *connection)
+{
+	abort_connection(connection, connection_state(S_ENCODE_ERROR));
+}
+
+/* Starts decoding the encoded file @name in the background. Returns 0 if
+ * the file should be read instead, like when it is not encoded. */
+static int
+decode_local_file(struct connection *connection, struct string *name)
+{
+	struct decoded_file_info *info;
+	struct stream_encoded *stream;
+	int readsize, encoded;
+
+	if (!get_opt_bool("protocol.file.background_decoding", NULL))
+		return 0;
+
+	/* Any errors are reported when reading the file. This also finds
+	 * the name with an encoding extension appended. */
+	if (!is_in_state(open_encoded_file(name, &stream, &readsize), S_OK))
+		return 0;
+
+	encoded = (stream->encoding != ENCODING_NONE);
+	close_encoded(stream);
+	if (!encoded) return 0;
+
+	connection->cached = get_cache_entry(connection->uri);
+	if (!connection->cached) return 0;
+
+	info = mem_calloc(1, sizeof(*info));
+	if (!info) return 0;
+
+	info->fd = start_thread(decoded_file_writer, name->source,
+				name->length + 1);
+	if (info->fd == -1) {
+		mem_free(info);
+		return 0;
+	}
+
+	connection->info = info;
+	connection->done = done_decoded_file;
+	connection->unrestartable = 1;
+
+	set_handlers(info->fd, (select_handler_T) read_decoded_file, NULL,
+		     (select_handler_T) error_decoded_file, connection);
+	set_connection_state(connection, connection_state(S_TRANS));
+	return 1;
+}
+
+#undef DECODED_FILE_BUFFER_SIZE
+
 /* To reduce redundant error handling code [calls to abort_connection()]
  * most of the function is build around conditions that will assign the error
  * code to @state if anything goes wrong. The rest of the function will then just
@@ -313,6 +539,15 @@ file_protocol_handler(struct connection *connection)
 			set_dir_content_type = 1;
 		}
 
+	} else if (map_local_file(connection, &name)) {
+		done_string(&name);
+		abort_connection(connection, connection_state(S_OK));
+		return;
+
+	} else if (decode_local_file(connection, &name)) {
+		done_string(&name);
+		return;
+
 	} else {
 		state = read_encoded_file(&name, &page);
 		/* FIXME: If state is now S_ENCODE_ERROR we should try loading
@@ -946,6 +946,8 @@ http_send_header(struct socket *socket)
 		add_to_string(&header, "Range: bytes=");
 		add_long_to_string(&header, conn->from ? conn->from : conn->progress->start);
 		add_char_to_string(&header, '-');
+		if (conn->range_end)
+			add_long_to_string(&header, conn->range_end - 1);
 		add_crlf_to_string(&header);
 	}
 
@@ -1061,20 +1063,49 @@ http_send_header(struct socket *socket)
 #undef POST_BUFFER_SIZE
 
 
-static char *
-decompress_data(struct connection *conn, char *data, int len,
-		int *new_len)
+/* The size of the pieces the decoded data is added to the cache in. It
+ * matches the padding of cache fragments, so they are filled whole. */
+#define DECODE_WINDOW_SIZE 16384
+
+/* Decodes @len bytes of the body into the cache at conn->from. The data
+ * is decoded a window at a time, so that a big chunk of compressed data
+ * never has to be decoded into one growing buffer. Returns the number of
+ * decoded bytes added to the cache. */
+static int
+decompress_data(struct connection *conn, char *data, int len)
 {
-	*new_len = 0; /* new_len must be zero if we would ever return NULL */
+	char window[DECODE_WINDOW_SIZE];
+	int total = 0;
+	int written;
 
 	if (!conn->stream) {
 		conn->stream = open_encoded(-1, conn->content_encoding);
-		if (!conn->stream) return NULL;
+		if (!conn->stream) return 0;
 	}
 
-	return decode_encoded_buffer(conn->stream, conn->content_encoding, data, len, new_len);
+	do {
+		int used;
+
+		written = decode_encoded(conn->stream, data, len, &used,
+					 window, DECODE_WINDOW_SIZE);
+		if (written < 0) break;
+
+		if (add_fragment(conn->cached, conn->from + total, window, written) == 1)
+			conn->tries = 0;
+
+		total += written;
+		data += used;
+		len -= used;
+		if (!written && !used) break;
+
+		/* A full window may leave more decoded data pending. */
+	} while (len > 0 || written == DECODE_WINDOW_SIZE);
+
+	return total;
 }
 
+#undef DECODE_WINDOW_SIZE
+
 static int
 is_line_in_buffer(struct read_buffer *rb)
 {
@@ -1211,12 +1242,7 @@ read_chunked_http_data(struct connection *conn, struct read_buffer *rb)
 				if (add_fragment(conn->cached, conn->from, rb->data, len) == 1)
 					conn->tries = 0;
 			} else {
-				char *data = decompress_data(conn, rb->data, len, &data_len);
-
-				if (add_fragment(conn->cached, conn->from, data, data_len) == 1)
-					conn->tries = 0;
-
-				mem_free_if(data);
+				data_len = decompress_data(conn, rb->data, len);
 				if (zero || !http->length) shutdown_connection_stream(conn);
 			}
 
@@ -1279,20 +1305,7 @@ read_normal_http_data(struct connection *conn, struct read_buffer *rb)
 		if (add_fragment(conn->cached, conn->from, rb->data, data_len) == 1)
 			conn->tries = 0;
 	} else {
-		char *data;
-finish:
-		data = decompress_data(conn, rb->data, len, &data_len);
-
-		if (!data && !http->length && len) {
-			kill_buffer_data(rb, len);
-			len = 0;
-			goto finish;
-		}
-
-		if (add_fragment(conn->cached, conn->from, data, data_len) == 1)
-			conn->tries = 0;
-
-		mem_free_if(data);
+		data_len = decompress_data(conn, rb->data, len);
 		if (!http->length) shutdown_connection_stream(conn);
 	}
 
@@ -1332,6 +1345,14 @@ read_http_data(struct socket *socket, struct read_buffer *rb)
 		ret = read_chunked_http_data(conn, rb);
 	}
 
+	if (ret > 0 && conn->range_end && conn->from >= conn->range_end
+	    && http->length) {
+		/* The rest of the document is loaded by other connections. */
+		http->close = 1;
+		http_end_request(conn, connection_state(S_OK), 1);
+		return;
+	}
+
 	switch (ret) {
 	case 0:
 		read_more_http_data(conn, rb, 0);
@@ -1573,7 +1594,9 @@ again:
 		return;
 	}
 
-	conn->cached = get_cache_entry(conn->uri);
+	/* A detached connection keeps loading into its own entry. */
+	if (!conn->detached || !conn->cached)
+		conn->cached = get_cache_entry(conn->uri);
 	if (!conn->cached) {
 		mem_free(head);
 		abort_connection(conn, connection_state(S_OUT_OF_MEM));
@@ -1752,9 +1775,11 @@ again:
 		mem_free(d);
 	}
 	if (cf && !conn->from && !conn->unrestartable) conn->unrestartable = 1;
-	if ((conn->progress->start <= 0 && conn->from > cf) || conn->from < 0) {
+	if ((conn->progress->start <= 0 && conn->from > cf) || conn->from < 0
+	    || (conn->range_end && conn->from != cf)) {
 		/* We don't want this if conn->progress.start because then conn->from will
-		 * be probably value of conn->progress.start, while cf is 0. */
+		 * be probably value of conn->progress.start, while cf is 0.
+		 * A connection loading a range must get exactly that. */
 		abort_connection(conn, connection_state(S_HTTP_ERROR));
 		return;
 	}
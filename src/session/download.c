@@ -126,6 +126,59 @@ init_file_download(struct uri *uri, struct session *ses, char *file, int fd)
 }
 
 
+/* Each segment of a split download loads at least this many bytes. */
+#define MIN_DOWNLOAD_SEGMENT_SIZE (1024 * 1024)
+
+/** One byte range of a download split by split_download(). */
+struct download_segment {
+	struct download download;
+	struct file_download *file_download;
+
+	/** Where the range ends in the file. */
+	off_t end;
+};
+
+struct download_segments {
+	/** Progress of all the segments together. */
+	struct progress *progress;
+
+	/** The size of the whole file. */
+	off_t length;
+
+	/** How much of the file was written before it was split. */
+	off_t base;
+
+	/** How much has been written since. */
+	off_t loaded;
+
+	int count;
+	struct download_segment segment[1]; /* Must be at end ! */
+};
+
+static void
+done_download_segments(struct file_download *file_download)
+{
+	struct download_segments *segments = file_download->segments;
+	int i;
+
+	if (!segments) return;
+
+	file_download->segments = NULL;
+
+	for (i = 0; i < segments->count; i++)
+		cancel_download(&segments->segment[i].download,
+				file_download->stop);
+
+	kill_timer(&segments->progress->timer);
+	done_progress(segments->progress);
+	mem_free(segments);
+
+	/* There is no connection behind it for cancel_download(). */
+	file_download->download.progress = NULL;
+	if (!is_in_result_state(file_download->download.state))
+		file_download->download.state = connection_state(S_INTERRUPTED);
+}
+
 void
 abort_download(struct file_download *file_download)
 {
@@ -143,6 +196,7 @@ abort_download(struct file_download *file_download)
 
 	if (file_download->dlg_data)
 		cancel_dialog(file_download->dlg_data, NULL);
+	done_download_segments(file_download);
 	cancel_download(&file_download->download, file_download->stop);
 	if (file_download->uri) done_uri(file_download->uri);
 
@@ -503,10 +557,210 @@ download_data_store(struct download *download, struct file_download *file_downlo
 	abort_download_and_beep(file_download, term);
 }
 
+/* Writes @length bytes of @data at @offset in the file. */
+static int
+write_file_range(int fd, char *data, off_t length, off_t offset)
+{
+	while (length > 0) {
+		ssize_t w;
+
+#ifdef HAVE_PWRITE
+		w = pwrite(fd, data, length, offset);
+		if (w == -1 && errno == EINTR) continue;
+#else
+		if (lseek(fd, offset, SEEK_SET) != offset)
+			return -1;
+		w = safe_write(fd, data, length);
+#endif
+		if (w <= 0) return -1;
+
+		data += w;
+		offset += w;
+		length -= w;
+	}
+
+	return 0;
+}
+
+/* Writes all that the segment has loaded so far to its place in the
+ * file and drops it from the cache. */
+static int
+write_download_segment(struct download_segment *segment)
+{
+	struct file_download *file_download = segment->file_download;
+	struct download_segments *segments = file_download->segments;
+	struct cache_entry *cached = segment->download.cached;
+	struct fragment *frag;
+	off_t end = 0;
+
+	if (!cached) return 1;
+
+	foreach (frag, cached->frag) {
+		/* The first connection may read past its range. */
+		off_t length = MIN(frag->length, segment->end - frag->offset);
+
+		end = frag->offset + frag->length;
+		if (length <= 0) continue;
+
+		if (write_file_range(file_download->handle, frag->data,
+				     length, frag->offset) < 0) {
+			download_error_dialog(file_download, errno);
+			return 0;
+		}
+
+		segments->loaded += length;
+		if (file_download->seek < frag->offset + length)
+			file_download->seek = frag->offset + length;
+	}
+
+	if (end) free_entry_to(cached, end);
+
+	return 1;
+}
+
+static void
+download_segments_stat_timer(struct file_download *file_download)
+{
+	struct download_segments *segments = file_download->segments;
+
+	update_progress(segments->progress, segments->loaded, segments->length,
+			segments->base + segments->loaded);
+
+	if (file_download->dlg_data)
+		redraw_dialog(file_download->dlg_data, 1);
+}
+
+static void
+download_segment_data(struct download *download, struct download_segment *segment)
+{
+	struct file_download *file_download = segment->file_download;
+	struct download_segments *segments = file_download->segments;
+	struct connection_state state = connection_state(S_OK);
+	int i;
+
+	/* Called from load_uri_range() in split_download(). */
+	if (!segments) return;
+
+	if (!write_download_segment(segment)) {
+		abort_download(file_download);
+		return;
+	}
+
+	for (i = 0; i < segments->count; i++) {
+		struct connection_state segment_state = segments->segment[i].download.state;
+
+		if (is_in_progress_state(segment_state)) {
+			state = connection_state(S_TRANS);
+
+		} else if (!is_in_state(segment_state, S_OK)) {
+			state = segment_state;
+			break;
+		}
+	}
+
+	file_download->download.state = state;
+	download_data_store(&file_download->download, file_download);
+}
+
+/* Splits the rest of the download into byte ranges which are loaded over
+ * connections of their own, if the server supports range requests and the
+ * download is big enough. The first range is left to the connection that
+ * has been loading the download. Returns whether the download was split. */
+static int
+split_download(struct file_download *file_download)
+{
+	struct download *download = &file_download->download;
+	struct connection *conn = download->conn;
+	struct download_segments *segments;
+	off_t base, length, range;
+	int count, i;
+
+	count = int_min(get_opt_int("document.download.segments", NULL),
+			get_opt_int("connection.max_connections_to_host", NULL));
+
+	if (count < 2
+	    || !conn || !is_in_state(download->state, S_TRANS)
+	    || (conn->proxied_uri->protocol != PROTOCOL_HTTP
+		&& conn->proxied_uri->protocol != PROTOCOL_HTTPS)
+	    || conn->unrestartable || conn->range_end
+	    || conn->content_encoding != ENCODING_NONE
+	    || conn->est_length <= 0
+	    || (download->progress && download->progress->seek))
+		return 0;
+
+	base = file_download->seek;
+	length = conn->est_length - conn->from;
+	while (count > 1 && length / count < MIN_DOWNLOAD_SEGMENT_SIZE)
+		count--;
+	if (count < 2) return 0;
+
+	/* The connection must not be shared with anybody, who would miss
+	 * the rest of the document. */
+	detach_connection(download, base, 1);
+	if (!conn->detached) return 0;
+
+	segments = mem_calloc(1, sizeof(*segments)
+				 + (count - 1) * sizeof(*segments->segment));
+	if (!segments) return 0;
+
+	segments->progress = init_progress(base);
+	if (!segments->progress) {
+		mem_free(segments);
+		return 0;
+	}
+
+	segments->length = conn->est_length;
+	segments->base = base;
+	segments->count = count;
+	range = length / count;
+
+	for (i = 0; i < count; i++) {
+		struct download_segment *segment = &segments->segment[i];
+		off_t start = conn->from + i * range;
+
+		segment->file_download = file_download;
+		segment->end = (i == count - 1) ? conn->est_length : start + range;
+		segment->download.callback = (download_callback_T *) download_segment_data;
+		segment->download.data = segment;
+
+		if (!i) continue;
+
+		if (load_uri_range(file_download->uri, conn->referrer,
+				   &segment->download, PRI_DOWNLOAD,
+				   start, segment->end) < 0) {
+			while (--i > 0)
+				cancel_download(&segments->segment[i].download, 1);
+			done_progress(segments->progress);
+			mem_free(segments);
+			return 0;
+		}
+	}
+
+	/* Hand the connection over to the first segment. From now on, the
+	 * file download itself is not attached to any connection. */
+	conn->range_end = segments->segment[0].end;
+	move_download(download, &segments->segment[0].download, PRI_DOWNLOAD);
+
+	download->conn = NULL;
+	download->cached = NULL;
+	download->progress = segments->progress;
+	download->state = connection_state(S_TRANS);
+	file_download->segments = segments;
+
+	start_update_progress(segments->progress,
+			      (void (*)(void *)) download_segments_stat_timer,
+			      file_download);
+	download_segments_stat_timer(file_download);
+
+	download_segment_data(&segments->segment[0].download, &segments->segment[0]);
+	return 1;
+}
+
 static void
 download_data(struct download *download, struct file_download *file_download)
 {
 	struct cache_entry *cached = download->cached;
+	int stream;
 
 	if (!cached || is_in_queued_state(download->state)) {
 		download_data_store(download, file_download);
@@ -537,13 +791,18 @@ download_data(struct download *download, struct file_download *file_download)
 		return;
 	}
 
+	if (split_download(file_download))
+		return;
+
+	stream = get_opt_bool("document.download.stream_to_disk", NULL);
+
 	if (!write_cache_entry_to_file(cached, file_download)) {
-		detach_connection(download, file_download->seek);
+		detach_connection(download, file_download->seek, stream);
 		abort_download(file_download);
 		return;
 	}
 
-	detach_connection(download, file_download->seek);
+	detach_connection(download, file_download->seek, stream);
 	download_data_store(download, file_download);
 }
 
@@ -21,6 +21,7 @@ struct session;
 struct uri;
 
 struct download;
+struct download_segments;
 
 typedef void (download_callback_T)(struct download *, void *);
 
@@ -150,6 +151,12 @@ struct file_download {
 	int notify;
 	struct download download;
 
+	/** The downloads of the byte ranges if split_download() has
+	 * split the download over several connections, else NULL.
+	 * #download then only holds the state and progress of them
+	 * all together. */
+	struct download_segments *segments;
+
 	/** Should the file be deleted when destroying the structure */
 	unsigned int delete_:1;
 
@@ -36,7 +36,6 @@ struct delayed_open {
 struct delayed_rel {
 	struct cache_entry *cached;
 	struct document *document;
-	struct session *ses;
 };
 
 enum remote_session_flags {
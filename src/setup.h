@@ -22,6 +22,8 @@
 
 #define ELINKS_SOCK_NAME		"socket"
 #define ELINKS_PORT			23456
+#define ELINKS_DUMP_SOCK_NAME		"dump-socket"
+#define ELINKS_DUMP_PORT		(ELINKS_PORT - 1)
 #define ELINKS_TEMPNAME_PREFIX		"elinks"
 
 #define ALLOWED_ECMASCRIPT_URL_PREFIXES	"allow.txt"
@@ -0,0 +1,119 @@
+/** Arena allocation
+ * @file */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "elinks.h"
+
+#include "util/arena.h"
+#include "util/memory.h"
+
+
+/** Size of the data area of a regular chunk. Requests bigger than this
+ * get a chunk of their own. */
+#define ARENA_CHUNK_SIZE	(16 * 1024 - 64)
+
+union arena_align {
+	long l;
+	double d;
+	void *p;
+};
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size; /**< Usable bytes in @c data. */
+	size_t used;
+	union arena_align data[1]; /* must be last of struct. */
+};
+
+#define ARENA_CHUNK_HEADER	offsetof(struct arena_chunk, data)
+#define ARENA_ROUND(size) \
+	(((size) + sizeof(union arena_align) - 1) & ~(sizeof(union arena_align) - 1))
+
+#ifdef DEBUG_ARENA
+
+void *
+debug_arena_alloc(const char *file, int line, struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+
+	chunk = debug_mem_alloc(file, line, ARENA_CHUNK_HEADER + size);
+	if (!chunk) return NULL;
+
+	chunk->size = chunk->used = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+
+	return chunk->data;
+}
+
+void *
+debug_arena_calloc(const char *file, int line, struct arena *arena, size_t size)
+{
+	void *p = debug_arena_alloc(file, line, arena, size);
+
+	if (p) memset(p, 0, size);
+	return p;
+}
+
+#else
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = arena->chunks;
+	void *p;
+
+	size = ARENA_ROUND(size);
+
+	if (!chunk || chunk->size - chunk->used < size) {
+		size_t chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+
+		chunk = mem_alloc(ARENA_CHUNK_HEADER + chunk_size);
+		if (!chunk) return NULL;
+
+		chunk->size = chunk_size;
+		chunk->used = 0;
+
+		/* Keep bumping in the current chunk if this one is filled
+		 * by the single oversized request. */
+		if (chunk_size > ARENA_CHUNK_SIZE && arena->chunks) {
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			chunk->next = arena->chunks;
+			arena->chunks = chunk;
+		}
+	}
+
+	p = (char *) chunk->data + chunk->used;
+	chunk->used += size;
+
+	return p;
+}
+
+void *
+arena_calloc(struct arena *arena, size_t size)
+{
+	void *p = arena_alloc(arena, size);
+
+	if (p) memset(p, 0, size);
+	return p;
+}
+
+#endif
+
+void
+done_arena(struct arena *arena)
+{
+	while (arena->chunks) {
+		struct arena_chunk *chunk = arena->chunks;
+
+		arena->chunks = chunk->next;
+		mem_free(chunk);
+	}
+}
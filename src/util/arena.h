@@ -0,0 +1,50 @@
+#ifndef EL__UTIL_ARENA_H
+#define EL__UTIL_ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct arena_chunk;
+
+/** Bump allocator for objects that all die together, e.g. the parts of
+ * one rendered document. There is no way to free a single object; all
+ * memory of the arena is released at once by done_arena().
+ *
+ * Zero-initialise the structure (or use #INIT_ARENA) before first use. */
+struct arena {
+	struct arena_chunk *chunks;
+};
+
+#define INIT_ARENA { NULL }
+
+/* With leak debugging, every object gets its own mem_alloc() block so
+ * that util/memdebug.c can still tell who allocated what. */
+#undef DEBUG_ARENA
+#ifdef DEBUG_MEMLEAK
+#define DEBUG_ARENA
+#endif
+
+#ifdef DEBUG_ARENA
+void *debug_arena_alloc(const char *file, int line, struct arena *arena, size_t size);
+void *debug_arena_calloc(const char *file, int line, struct arena *arena, size_t size);
+#define arena_alloc(arena, size) debug_arena_alloc(__FILE__, __LINE__, arena, size)
+#define arena_calloc(arena, size) debug_arena_calloc(__FILE__, __LINE__, arena, size)
+#else
+/** Returns @a size bytes aligned for any object, or NULL. */
+void *arena_alloc(struct arena *arena, size_t size);
+/** Like arena_alloc() but the memory is cleared. */
+void *arena_calloc(struct arena *arena, size_t size);
+#endif
+
+/** Frees everything allocated from @a arena and leaves it empty and
+ * ready for reuse. */
+void done_arena(struct arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
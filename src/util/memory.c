@@ -10,6 +10,7 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #ifdef HAVE_MMAP
 #include <sys/mman.h>
@@ -51,6 +52,248 @@ patience(char *of)
 	return 0;
 }
 
+#ifdef CONFIG_MEMPOOL
+
+/* Size-class pool allocator.
+ *
+ * Requests of up to MEM_POOL_MAX_SIZE bytes are rounded up to a multiple
+ * of MEM_POOL_GRANULARITY and served from the free list of that class.
+ * When the list is empty, a new slot is cut from the current slab of the
+ * class, and when that is used up a new MEM_POOL_SLAB_SIZE slab is taken
+ * from malloc(). Slabs are never given back. Bigger requests go straight
+ * to malloc().
+ *
+ * Every block, pooled or not, starts with a header holding the requested
+ * size, which tells mem_free() and mem_realloc() where the block came
+ * from. Memory from mem_alloc() must therefore never be released with
+ * free(), and the other way round. */
+
+#define MEM_POOL_GRANULARITY	16
+#define MEM_POOL_CLASSES	16
+#define MEM_POOL_MAX_SIZE	(MEM_POOL_GRANULARITY * MEM_POOL_CLASSES)
+#define MEM_POOL_SLAB_SIZE	(64 * 1024)
+
+/* Keeps the data as aligned as malloc() would. */
+union mem_pool_header {
+	size_t size;
+	char pad[MEM_POOL_GRANULARITY];
+};
+
+#define MEM_POOL_HEADER		sizeof(union mem_pool_header)
+#define mem_pool_class(size)	(((size) - 1) / MEM_POOL_GRANULARITY)
+#define mem_pool_slot_size(c)	(MEM_POOL_HEADER + ((c) + 1) * MEM_POOL_GRANULARITY)
+
+struct mem_pool_slot {
+	struct mem_pool_slot *next;
+};
+
+struct mem_pool_class {
+	struct mem_pool_slot *free_slots;
+	char *slab;
+	char *slab_end;
+	char lock;
+};
+
+static struct mem_pool_class mem_pool[MEM_POOL_CLASSES];
+
+struct mem_pool_stats mem_pool_stats;
+
+/* ELinks itself is single-threaded, but libraries may call mem_alloc()
+ * from their own threads. Each class has its own tiny spinlock. */
+#ifdef __GNUC__
+#define mem_pool_lock(class_) \
+	while (__atomic_test_and_set(&(class_)->lock, __ATOMIC_ACQUIRE))
+#define mem_pool_unlock(class_) \
+	__atomic_clear(&(class_)->lock, __ATOMIC_RELEASE)
+#define mem_pool_count(var, n) \
+	__atomic_add_fetch(&mem_pool_stats.var, (n), __ATOMIC_RELAXED)
+#else
+#define mem_pool_lock(class_)
+#define mem_pool_unlock(class_)
+#define mem_pool_count(var, n) (mem_pool_stats.var += (n))
+#endif
+
+static union mem_pool_header *
+mem_pool_get(size_t size)
+{
+	struct mem_pool_class *class_ = &mem_pool[mem_pool_class(size)];
+	size_t slot_size = mem_pool_slot_size(mem_pool_class(size));
+	union mem_pool_header *header;
+
+	mem_pool_lock(class_);
+
+	if (class_->free_slots) {
+		header = (union mem_pool_header *) class_->free_slots;
+		class_->free_slots = class_->free_slots->next;
+
+	} else {
+		if (class_->slab_end - class_->slab < (long) slot_size) {
+			char *slab;
+
+			do {
+				slab = malloc(MEM_POOL_SLAB_SIZE);
+			} while (!slab && patience("malloc"));
+
+			if (!slab) {
+				mem_pool_unlock(class_);
+				return NULL;
+			}
+
+			class_->slab = slab;
+			class_->slab_end = slab + MEM_POOL_SLAB_SIZE;
+			mem_pool_count(slabs, MEM_POOL_SLAB_SIZE);
+		}
+
+		header = (union mem_pool_header *) class_->slab;
+		class_->slab += slot_size;
+	}
+
+	mem_pool_unlock(class_);
+
+	header->size = size;
+	mem_pool_count(used, size);
+
+	return header;
+}
+
+static void
+mem_pool_put(union mem_pool_header *header)
+{
+	struct mem_pool_class *class_ = &mem_pool[mem_pool_class(header->size)];
+	struct mem_pool_slot *slot = (struct mem_pool_slot *) header;
+
+	mem_pool_count(used, -(long) header->size);
+
+	mem_pool_lock(class_);
+	slot->next = class_->free_slots;
+	class_->free_slots = slot;
+	mem_pool_unlock(class_);
+}
+
+void *
+mem_alloc(size_t size)
+{
+	union mem_pool_header *header;
+
+	if (!size) return NULL;
+
+	if (size <= MEM_POOL_MAX_SIZE) {
+		header = mem_pool_get(size);
+
+	} else {
+		do {
+			header = malloc(MEM_POOL_HEADER + size);
+		} while (!header && patience("malloc"));
+
+		if (!header) return NULL;
+
+		header->size = size;
+		mem_pool_count(large, size);
+	}
+
+	return header ? header + 1 : NULL;
+}
+
+void *
+mem_calloc(size_t count, size_t eltsize)
+{
+	union mem_pool_header *header;
+	size_t size = count * eltsize;
+
+	if (!eltsize || !count || size / eltsize != count)
+		return NULL;
+
+	if (size <= MEM_POOL_MAX_SIZE) {
+		header = mem_pool_get(size);
+		if (!header) return NULL;
+
+		memset(header + 1, 0, size);
+
+	} else {
+		do {
+			header = calloc(1, MEM_POOL_HEADER + size);
+		} while (!header && patience("calloc"));
+
+		if (!header) return NULL;
+
+		header->size = size;
+		mem_pool_count(large, size);
+	}
+
+	return header + 1;
+}
+
+void
+mem_free(void *p)
+{
+	union mem_pool_header *header;
+
+	if (!p) {
+		INTERNAL("mem_free(NULL)");
+		return;
+	}
+
+	header = (union mem_pool_header *) p - 1;
+
+	if (header->size <= MEM_POOL_MAX_SIZE) {
+		mem_pool_put(header);
+	} else {
+		mem_pool_count(large, -(long) header->size);
+		free(header);
+	}
+}
+
+void *
+mem_realloc(void *p, size_t size)
+{
+	union mem_pool_header *header;
+	void *p2;
+
+	if (!p) return mem_alloc(size);
+
+	if (!size) {
+		mem_free(p);
+		return NULL;
+	}
+
+	header = (union mem_pool_header *) p - 1;
+
+	if (header->size <= MEM_POOL_MAX_SIZE) {
+		/* Still fits the same slot. */
+		if (size <= MEM_POOL_MAX_SIZE
+		    && mem_pool_class(size) == mem_pool_class(header->size)) {
+			mem_pool_count(used, (long) size - (long) header->size);
+			header->size = size;
+			return p;
+		}
+
+	} else if (size > MEM_POOL_MAX_SIZE) {
+		union mem_pool_header *header2;
+
+		do {
+			header2 = realloc(header, MEM_POOL_HEADER + size);
+		} while (!header2 && patience("realloc"));
+
+		if (!header2) return NULL;
+
+		mem_pool_count(large, (long) size - (long) header2->size);
+		header2->size = size;
+
+		return header2 + 1;
+	}
+
+	/* Moving between the pool and malloc(), or between two classes. */
+	p2 = mem_alloc(size);
+	if (!p2) return NULL;
+
+	memcpy(p2, p, MIN(size, header->size));
+	mem_free(p);
+
+	return p2;
+}
+
+#else /* CONFIG_MEMPOOL */
+
 void *
 mem_alloc(size_t size)
 {
@@ -101,6 +344,8 @@ mem_realloc(void *p, size_t size)
 	return NULL;
 }
 
+#endif /* CONFIG_MEMPOOL */
+
 #endif
 
 
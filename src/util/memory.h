@@ -53,6 +53,16 @@ void *mem_calloc(size_t, size_t);
 void mem_free(void *);
 void *mem_realloc(void *, size_t);
 
+#ifdef CONFIG_MEMPOOL
+struct mem_pool_stats {
+	long used;  /**< Bytes requested by live pooled objects. */
+	long slabs; /**< Bytes taken from malloc() for the pool. */
+	long large; /**< Bytes in blocks too big for the pool. */
+};
+
+extern struct mem_pool_stats mem_pool_stats;
+#endif
+
 #else
 
 # include <stdlib.h>
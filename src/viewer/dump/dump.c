@@ -4,8 +4,10 @@
 #include "config.h"
 #endif
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/types.h> /* NetBSD flavour */
 #ifdef HAVE_FCNTL_H
@@ -20,14 +22,19 @@
 #include "cache/cache.h"
 #include "config/options.h"
 #include "document/document.h"
+#include "document/forms.h"
 #include "document/html/renderer.h"
 #include "document/options.h"
+#include "document/plain/renderer.h"
 #include "document/renderer.h"
 #include "document/view.h"
+#include "encoding/encoding.h"
 #include "intl/charsets.h"
 #include "intl/libintl.h"
+#include "main/interlink.h"
 #include "main/select.h"
 #include "main/main.h"
+#include "mime/mime.h"
 #include "network/connection.h"
 #include "network/state.h"
 #include "osdep/ascii.h"
@@ -50,6 +57,33 @@ static int dump_pos;
 static struct download dump_download;
 static int dump_redir_count = 0;
 
+static INIT_LIST_OF(struct string_list_item, todo_list);
+static INIT_LIST_OF(struct string_list_item, done_list);
+
+/* With document.dump.parallel above one, up to that many URLs are loaded
+ * at once through the connection queue. Each of them is dumped into a
+ * string once loaded, and the strings are written out in the order the
+ * URLs were given. */
+struct dump_request {
+	LIST_HEAD(struct dump_request);
+
+	struct download download;
+	struct string_list_item *item;
+	struct string output;
+	int redir_count;
+	unsigned int done:1;
+};
+
+static INIT_LIST_OF(struct dump_request, dump_requests);
+
+/* Formatting parameters of one dump. */
+struct dump_settings {
+	int width;
+	int codepage;
+	int color_mode;
+	unsigned int jsonl:1;
+};
+
 #define D_BUF	65536
 
 #define FRAME_CHARS_BEGIN 0xB0
@@ -319,51 +353,81 @@ write_true_color(const char *str, const unsigned char *color,
 #undef DUMP_FUNCTION_UTF8
 #undef DUMP_FUNCTION_UNIBYTE
 
-/*! @return 0 on success, -1 on error */
+/** Write @a length bytes straight to the file or string, bypassing
+ * the buffer, which must have been flushed.
+ *
+ * @return 0 on success, or -1 on error.
+ *
+ * @relates dump_output */
 static int
-dump_references(struct document *document, int fd, char buf[D_BUF])
+dump_output_write(struct dump_output *out, char *data, int length)
 {
-	if (document->nlinks
-	    && get_opt_bool("document.dump.references", NULL)) {
-		char key_sym[64] = {0};
-		int x;
-		char *header = "\nReferences\n\n   Visible links\n";
-		const char *label_key = get_opt_str("document.browse.links.label_key", NULL);
-		int headlen = strlen(header);
-		int base = strlen(label_key);
-
-		if (hard_write(fd, header, headlen) != headlen)
-			return -1;
+	if (out->string)
+		return add_bytes_to_string(out->string, data, length) ? 0 : -1;
+
+	return hard_write(out->fd, data, length) == length ? 0 : -1;
+}
 
-		for (x = 0; x < document->nlinks; x++) {
-			struct link *link = &document->links[x];
-			char *where = link->where;
-			size_t reflen;
+/*! Writes the references of @document's links, numbering them from
+ * @number + 1 on.
+ * @return 0 on success, -1 on error */
+static int
+dump_link_references(struct document *document, struct dump_output *out,
+		     int number)
+{
+	char *buf = out->buf;
+	char key_sym[64] = {0};
+	int x;
+	const char *label_key = get_opt_str("document.browse.links.label_key", NULL);
+	int base = strlen(label_key);
 
-			if (!where) continue;
+	for (x = 0; x < document->nlinks; x++) {
+		struct link *link = &document->links[x];
+		char *where = link->where;
+		size_t reflen;
 
-			if (document->options.links_numbering) {
+		if (!where) continue;
 
-				dec2qwerty(x + 1, key_sym, label_key, base);
+		if (document->options.links_numbering) {
 
-				if (link->title && *link->title)
-					snprintf(buf, D_BUF, "%4s. %s\n\t%s\n",
-						 key_sym, link->title, where);
-				else
-					snprintf(buf, D_BUF, "%4s. %s\n",
-						 key_sym, where);
-			} else {
-				if (link->title && *link->title)
-					snprintf(buf, D_BUF, "   . %s\n\t%s\n",
-						 link->title, where);
-				else
-					snprintf(buf, D_BUF, "   . %s\n", where);
-			}
+			dec2qwerty(number + x + 1, key_sym, label_key, base);
 
-			reflen = strlen(buf);
-			if (hard_write(fd, buf, reflen) != reflen)
-				return -1;
+			if (link->title && *link->title)
+				snprintf(buf, D_BUF, "%4s. %s\n\t%s\n",
+					 key_sym, link->title, where);
+			else
+				snprintf(buf, D_BUF, "%4s. %s\n",
+					 key_sym, where);
+		} else {
+			if (link->title && *link->title)
+				snprintf(buf, D_BUF, "   . %s\n\t%s\n",
+					 link->title, where);
+			else
+				snprintf(buf, D_BUF, "   . %s\n", where);
 		}
+
+		reflen = strlen(buf);
+		if (dump_output_write(out, buf, reflen))
+			return -1;
+	}
+
+	return 0;
+}
+
+#define DUMP_REFERENCES_HEADER "\nReferences\n\n   Visible links\n"
+
+/*! @return 0 on success, -1 on error */
+static int
+dump_references(struct document *document, struct dump_output *out)
+{
+	if (document->nlinks
+	    && get_opt_bool("document.dump.references", NULL)) {
+		char *header = DUMP_REFERENCES_HEADER;
+
+		if (dump_output_write(out, header, strlen(header)))
+			return -1;
+
+		return dump_link_references(document, out, 0);
 	}
 
 	return 0;
@@ -378,283 +442,1039 @@ dump_to_file(struct document *document, int fd)
 
 	if (!out) return -1;
 
+	render_plain_lines(document, 0, document->height);
 	error = dump_nocolor(document, out);
 	if (!error)
-		error = dump_references(document, fd, out->buf);
+		error = dump_references(document, out);
 
 	mem_free(out);
 	return error;
 }
 
-/* This dumps the given @cached's formatted output onto @fd. */
-static void
-dump_formatted(int fd, struct download *download, struct cache_entry *cached)
+static int
+is_jsonl_dump(void)
 {
-	struct document_options o;
-	struct document_view formatted;
-	struct view_state vs;
-	int width;
-	struct dump_output *out;
-
-	if (!cached) return;
-
-	memset(&formatted, 0, sizeof(formatted));
-
-	init_document_options(NULL, &o);
-	width = get_opt_int("document.dump.width", NULL);
-	set_box(&o.box, 0, 1, width, DEFAULT_TERMINAL_HEIGHT);
-
-	o.cp = get_opt_codepage("document.dump.codepage", NULL);
-	o.color_mode = get_opt_int("document.dump.color_mode", NULL);
-	o.plain = 0;
-	o.frames = 0;
-	o.links_numbering = get_opt_bool("document.dump.numbering", NULL);
-	o.dump = 1;
-
-#ifdef CONFIG_SCRIPTING
-	maybe_pre_format_html(cached, NULL);
-#endif
-
-	init_vs(&vs, cached->uri, -1);
+	return !c_strcasecmp(get_opt_str("document.dump.format", NULL), "jsonl");
+}
 
-	render_document(&vs, &formatted, &o);
+static void
+get_dump_settings(struct dump_settings *settings)
+{
+	settings->width = get_opt_int("document.dump.width", NULL);
+	settings->codepage = get_opt_codepage("document.dump.codepage", NULL);
+	settings->color_mode = get_opt_int("document.dump.color_mode", NULL);
+	settings->jsonl = is_jsonl_dump();
+}
 
-	out = dump_output_alloc(fd, NULL, o.cp);
-	if (out) {
-		int error;
+static void
+init_dump_options(struct document_options *o, struct dump_settings *settings)
+{
+	init_document_options(NULL, o);
+	set_box(&o->box, 0, 1, settings->width, DEFAULT_TERMINAL_HEIGHT);
+	o->document_width = settings->width;
+
+	/* JSON text is always UTF-8. */
+	o->cp = settings->jsonl ? get_cp_index("utf-8") : settings->codepage;
+	o->color_mode = settings->color_mode;
+	o->plain = 0;
+	o->frames = 0;
+	o->links_numbering = get_opt_bool("document.dump.numbering", NULL);
+	o->dump = 1;
+}
 
-		switch (o.color_mode) {
-		case COLOR_MODE_DUMP:
-		case COLOR_MODE_MONO: /* FIXME: inversion */
-			error = dump_nocolor(formatted.document, out);
-			break;
+/*! @return 0 on success, -1 on error */
+static int
+dump_document(struct document *document, struct dump_output *out)
+{
+	switch (document->options.color_mode) {
+	case COLOR_MODE_DUMP:
+	case COLOR_MODE_MONO: /* FIXME: inversion */
+		return dump_nocolor(document, out);
 
-		default:
-			/* If the desired color mode was not compiled in,
-			 * use 16 colors.  */
-		case COLOR_MODE_16:
-			error = dump_16color(formatted.document, out);
-			break;
+	default:
+		/* If the desired color mode was not compiled in,
+		 * use 16 colors.  */
+	case COLOR_MODE_16:
+		return dump_16color(document, out);
 
 #ifdef CONFIG_88_COLORS
-		case COLOR_MODE_88:
-			error = dump_256color(formatted.document, out);
-			break;
+	case COLOR_MODE_88:
+		return dump_256color(document, out);
 #endif
 
 #ifdef CONFIG_256_COLORS
-		case COLOR_MODE_256:
-			error = dump_256color(formatted.document, out);
-			break;
+	case COLOR_MODE_256:
+		return dump_256color(document, out);
 #endif
 
 #ifdef CONFIG_TRUE_COLOR
-		case COLOR_MODE_TRUE_COLOR:
-			error = dump_truecolor(formatted.document, out);
-			break;
+	case COLOR_MODE_TRUE_COLOR:
+		return dump_truecolor(document, out);
 #endif
-		}
-
-		if (!error)
-			dump_references(formatted.document, fd, out->buf);
-
-		mem_free(out);
-	} /* if out */
-
-	detach_formatted(&formatted);
-	destroy_vs(&vs, 1);
+	}
 }
 
-#undef D_BUF
+/* The jsonl dump format writes one JSON object per line, each with a "type"
+ * member: a "document" record with the URL and title, then a "line" record
+ * for each line of the formatted text, a "link" record for each link with
+ * the line and column spans it covers on the screen, and a "form" record
+ * for each form followed by a "field" record for each of its controls.
+ * Lines and columns are counted from 0, links and forms from 1. */
 
-/* This dumps the given @cached's source onto @fd nothing more. It returns 0 if it
- * all went fine and 1 if something isn't quite right and we should terminate
- * ourselves ASAP. */
-static int
-dump_source(int fd, struct download *download, struct cache_entry *cached)
+/* Adds @len bytes of the UTF-8 @str as a JSON string. Bytes that are not
+ * valid UTF-8 come out as U+FFFD, so the record is always valid JSON. */
+static void
+add_json_string(struct string *string, const char *str, int len)
 {
-	struct fragment *frag;
+	const char *end = str + len;
 
-	if (!cached) return 0;
-
-nextfrag:
-	foreach (frag, cached->frag) {
-		int d = dump_pos - frag->offset;
-		int l, w;
+	add_char_to_string(string, '"');
 
-		if (d < 0 || frag->length <= d)
-			continue;
+	for (; str < end; str++) {
+		unsigned char c = *str;
 
-		l = frag->length - d;
-		w = hard_write(fd, frag->data + d, l);
+		if (c >= 0x80) {
+			char *next = (char *) str;
+			unicode_val_T u = utf8_to_unicode(&next, end);
 
-		if (w != l) {
-			detach_connection(download, dump_pos);
+			if (u == UCS_NO_CHAR || u == UCS_REPLACEMENT_CHARACTER) {
+				add_to_string(string, "\\ufffd");
+			} else {
+				add_bytes_to_string(string, str, next - str);
+				str = next - 1;
+			}
+			continue;
+		}
 
-			if (w < 0)
-				ERROR(gettext("Can't write to stdout: %s"),
-				      (char *) strerror(errno));
+		switch (c) {
+		case '"':
+			add_to_string(string, "\\\"");
+			break;
+		case '\\':
+			add_to_string(string, "\\\\");
+			break;
+		case '\n':
+			add_to_string(string, "\\n");
+			break;
+		case '\r':
+			add_to_string(string, "\\r");
+			break;
+		case '\t':
+			add_to_string(string, "\\t");
+			break;
+		default:
+			if (c < 0x20)
+				add_format_to_string(string, "\\u%04x", c);
 			else
-				ERROR(gettext("Can't write to stdout."));
-
-			program.retval = RET_ERROR;
-			return 1;
+				add_char_to_string(string, c);
 		}
-
-		dump_pos += w;
-		detach_connection(download, dump_pos);
-		goto nextfrag;
 	}
 
-	return 0;
+	add_char_to_string(string, '"');
 }
 
-static char *
-subst_url(char *str, struct string *url)
+/* Adds @str, which is in the charset @cp, as a JSON string. A @cp of -1
+ * is for our own ASCII strings, which need no conversion. */
+static void
+add_json_text(struct string *string, char *str, int cp)
 {
-	struct string string;
+	int utf8_cp = get_cp_index("utf-8");
+	struct conv_table *table;
+	char *utf8;
+	int length;
 
-	if (!init_string(&string)) return NULL;
-
-	while (*str) {
-		int p;
+	if (cp == -1) {
+		add_json_string(string, str, strlen(str));
+		return;
+	}
 
-		for (p = 0; str[p] && str[p] != '%' && str[p] != '\\'; p++);
+	table = get_translation_table(cp, utf8_cp);
+	utf8 = convert_string(table, str, strlen(str), utf8_cp, CSM_NONE,
+			      &length, NULL, NULL);
+	if (utf8) {
+		add_json_string(string, utf8, length);
+		mem_free(utf8);
+	} else {
+		add_to_string(string, "null");
+	}
+}
 
-		add_bytes_to_string(&string, str, p);
-		str += p;
+/* Adds the member @name with the value @str in the charset @cp, or null
+ * if there is none. */
+static void
+add_json_member(struct string *string, const char *name, char *str, int cp)
+{
+	add_format_to_string(string, ",\"%s\":", name);
 
-		if (*str == '\\') {
-			unsigned char ch;
+	if (!str)
+		add_to_string(string, "null");
+	else
+		add_json_text(string, str, cp);
+}
 
-			str++;
-			switch (*str) {
-				case 'f':
-					ch = '\f';
-					break;
-				case 'n':
-					ch = '\n';
-					break;
-				case 't':
-					ch = '\t';
-					break;
-				default:
-					ch = *str;
-			}
-			if (*str) {
-				add_char_to_string(&string, ch);
-				str++;
-			}
-			continue;
+/* Writes the record in @record and empties it for the next one. */
+static int
+dump_jsonl_record(struct dump_output *out, struct string *record)
+{
+	int error;
 
-		} else if (*str != '%') {
-			break;
-		}
+	add_char_to_string(record, '\n');
+	error = dump_output_write(out, record->source, record->length);
+	record->length = 0;
 
-		str++;
-		switch (*str) {
-			case 'u':
-				if (url) add_string_to_string(&string, url);
-				break;
-		}
+	return error;
+}
 
-		if (*str) str++;
+static void
+add_jsonl_link(struct string *record, struct document *document,
+	       int number)
+{
+	struct link *link = &document->links[number];
+	struct el_form_control *fc = get_link_form_control(link);
+	int i;
+
+	add_format_to_string(record, "{\"type\":\"link\",\"number\":%d",
+			     number + 1);
+	add_json_member(record, "kind", fc ? form_type2str(fc->type)
+			: link->type == LINK_MAP ? "map" : "hypertext",
+			-1);
+	add_json_member(record, "url", link->where, document->cp);
+	add_json_member(record, "image", link->where_img, document->cp);
+	add_json_member(record, "target", link->target, document->cp);
+	add_json_member(record, "title", link->title, document->cp);
+
+	/* Consecutive points on one line make up one span. */
+	add_to_string(record, ",\"spans\":[");
+	for (i = 0; i < link->npoints;) {
+		struct point *start = &link->points[i];
+		int length = 1;
+
+		while (i + length < link->npoints
+		       && link->points[i + length].y == start->y
+		       && link->points[i + length].x == start->x + length)
+			length++;
+
+		add_format_to_string(record,
+				     "%s{\"line\":%d,\"column\":%d,\"length\":%d}",
+				     i ? "," : "", start->y, start->x, length);
+		i += length;
 	}
-
-	return string.source;
+	add_to_string(record, "]}");
 }
 
 static void
-dump_print(char *option, struct string *url)
+add_jsonl_field(struct string *record, struct document *document,
+		struct el_form_control *fc, int form_number)
 {
-	char *str = get_opt_str(option, NULL);
+	int link = get_form_control_link(document, fc);
+
+	add_format_to_string(record, "{\"type\":\"field\",\"form\":%d",
+			     form_number);
+	add_json_member(record, "kind", form_type2str(fc->type), -1);
+	add_json_member(record, "name", fc->name, document->cp);
+	add_json_member(record, "id", fc->id, document->cp);
+
+	/* The file name of FC_FILE is never preset. */
+	if (fc->type == FC_CHECKBOX || fc->type == FC_RADIO) {
+		add_json_member(record, "value", fc->default_value,
+				document->cp);
+		add_format_to_string(record, ",\"checked\":%s",
+				     fc->default_state ? "true" : "false");
+	} else if (fc->type != FC_FILE) {
+		add_json_member(record, "value", fc->default_value,
+				document->cp);
+	}
 
-	if (str) {
-		char *realstr = subst_url(str, url);
+	if (fc->type == FC_SELECT && fc->nvalues > 0) {
+		int i;
 
-		if (realstr) {
-			printf("%s", realstr);
-			fflush(stdout);
-			mem_free(realstr);
+		add_to_string(record, ",\"options\":[");
+		for (i = 0; i < fc->nvalues; i++) {
+			if (i) add_char_to_string(record, ',');
+			add_json_text(record, fc->values[i], document->cp);
 		}
+		add_char_to_string(record, ']');
 	}
+
+	if (fc->mode != FORM_MODE_NORMAL)
+		add_format_to_string(record, ",\"mode\":\"%s\"",
+				     fc->mode == FORM_MODE_READONLY
+				     ? "readonly" : "disabled");
+
+	if (link >= 0)
+		add_format_to_string(record, ",\"link\":%d", link + 1);
+	else
+		add_to_string(record, ",\"link\":null");
+
+	add_char_to_string(record, '}');
 }
 
-static void
-dump_loading_callback(struct download *download, void *p)
+static const char *
+get_form_method_name(enum form_method method)
 {
-	struct cache_entry *cached = download->cached;
-	int fd = get_output_handle();
+	switch (method) {
+	case FORM_METHOD_GET:
+		return "get";
+	case FORM_METHOD_POST_MP:
+		return "multipart";
+	case FORM_METHOD_POST_TEXT_PLAIN:
+		return "text/plain";
+	case FORM_METHOD_POST:
+	default:
+		return "post";
+	}
+}
 
-	if (fd == -1) return;
-	if (cached && cached->redirect && dump_redir_count++ < MAX_REDIRECTS) {
-		struct uri *uri = cached->redirect;
+/*! @return 0 on success, -1 on error */
+static int
+dump_jsonl(struct document *document, struct dump_output *out)
+{
+	struct dump_output *text_out;
+	struct string text, record;
+	struct form *form;
+	int error, x, y, start;
+	int form_number = 0;
+
+	/* The text is dumped the usual way first and then split up, so that
+	 * frame characters and the like come out as in the text format. */
+	if (!init_string(&text)) return -1;
+	text_out = dump_output_alloc(-1, &text, document->options.cp);
+	if (!text_out) {
+		done_string(&text);
+		return -1;
+	}
+	error = dump_nocolor(document, text_out);
+	mem_free(text_out);
 
-		cancel_download(download, 0);
+	if (error || !init_string(&record)) {
+		done_string(&text);
+		return -1;
+	}
 
-		load_uri(uri, cached->uri, download, PRI_MAIN, 0, -1);
-		return;
+	add_to_string(&record, "{\"type\":\"document\"");
+	add_json_member(&record, "url", struri(document->uri), document->cp);
+	/* The renderer has converted the title to the output charset. */
+	add_json_member(&record, "title", document->title,
+			document->options.cp);
+	add_format_to_string(&record,
+			     ",\"width\":%d,\"lines\":%d,\"links\":%d}",
+			     document->width, document->height,
+			     document->nlinks);
+	error = dump_jsonl_record(out, &record);
+
+	for (x = start = y = 0; !error && x < text.length; x++) {
+		if (text.source[x] != '\n') continue;
+
+		add_format_to_string(&record,
+				     "{\"type\":\"line\",\"line\":%d,\"text\":", y++);
+		add_json_string(&record, &text.source[start], x - start);
+		add_char_to_string(&record, '}');
+		error = dump_jsonl_record(out, &record);
+		start = x + 1;
 	}
 
-	if (is_in_queued_state(download->state)) return;
+	for (x = 0; !error && x < document->nlinks; x++) {
+		add_jsonl_link(&record, document, x);
+		error = dump_jsonl_record(out, &record);
+	}
 
-	if (get_cmd_opt_bool("dump")) {
-		if (is_in_transfering_state(download->state))
-			return;
+	/* Both lists are kept with the last one seen in the source first. */
+	foreachback (form, document->forms) {
+		struct el_form_control *fc;
 
-		dump_formatted(fd, download, cached);
+		if (error) break;
 
-	} else {
-		if (dump_source(fd, download, cached) > 0)
-			goto terminate;
+		add_format_to_string(&record, "{\"type\":\"form\",\"number\":%d",
+				     ++form_number);
+		add_json_member(&record, "name", form->name, document->cp);
+		add_json_member(&record, "action", form->action, document->cp);
+		add_json_member(&record, "method",
+				(char *) get_form_method_name(form->method),
+				-1);
+		add_json_member(&record, "target", form->target, document->cp);
+		add_char_to_string(&record, '}');
+		error = dump_jsonl_record(out, &record);
 
-		if (is_in_progress_state(download->state))
-			return;
+		foreachback (fc, form->items) {
+			if (error) break;
 
+			add_jsonl_field(&record, document, fc, form_number);
+			error = dump_jsonl_record(out, &record);
+		}
 	}
 
-	if (!is_in_state(download->state, S_OK)) {
-		usrerror(get_state_message(download->state, NULL));
-		program.retval = RET_ERROR;
-		goto terminate;
-	}
+	done_string(&record);
+	done_string(&text);
 
-terminate:
-	program.terminate = 1;
-	dump_next(NULL);
+	return error;
 }
 
-static void
-dump_start(char *url)
+/* Plain text is dumped through the plain text renderer rather than as HTML
+ * when it may be streamed, so that the output is the same whether it was
+ * or not. */
+static int
+dump_as_plain_text(struct cache_entry *cached)
 {
-	char *wd = get_cwd();
-	struct uri *uri = get_translated_uri(url, wd);
-
-	mem_free_if(wd);
+	char *content_type;
 
-	if (!uri || get_protocol_external_handler(NULL, uri)) {
-		usrerror(gettext("URL protocol not supported (%s)."), url);
-		goto terminate;
-	}
+	if (!get_opt_bool("document.dump.stream", NULL) || is_jsonl_dump())
+		return 0;
 
-	dump_download.callback = (download_callback_T *) dump_loading_callback;
-	dump_pos = 0;
+	content_type = get_content_type(cached);
 
-	if (load_uri(uri, NULL, &dump_download, PRI_MAIN, 0, -1)) {
-terminate:
-		dump_next(NULL);
-		program.terminate = 1;
-		program.retval = RET_SYNTAX;
-	}
+	return content_type && !c_strcasecmp(content_type, "text/plain");
+}
+
+/* This dumps the given @cached's formatted output onto @fd, or appends it
+ * to @string if @fd is -1. */
+static void
+dump_formatted(int fd, struct string *string, struct download *download,
+	       struct cache_entry *cached, struct dump_settings *settings)
+{
+	struct document_options o;
+	struct document_view formatted;
+	struct view_state vs;
+	struct dump_output *out;
+
+	if (!cached) return;
+
+	memset(&formatted, 0, sizeof(formatted));
+
+	init_dump_options(&o, settings);
+	o.plain = dump_as_plain_text(cached);
+
+#ifdef CONFIG_SCRIPTING
+	maybe_pre_format_html(cached, NULL);
+#endif
+
+	init_vs(&vs, cached->uri, -1);
+
+	render_document(&vs, &formatted, &o);
+
+	out = dump_output_alloc(fd, string, o.cp);
+	if (out) {
+		if (settings->jsonl)
+			dump_jsonl(formatted.document, out);
+		else if (!dump_document(formatted.document, out))
+			dump_references(formatted.document, out);
+
+		mem_free(out);
+	} /* if out */
+
+	detach_formatted(&formatted);
+	destroy_vs(&vs, 1);
+}
+
+/* With document.dump.stream, plain text documents are formatted and written
+ * in pieces while they are still being loaded. A piece ends after a line the
+ * renderer does not need to look back at, so that it comes out the same as
+ * if the whole document were rendered at once, and the dumped data is then
+ * dropped from the cache entry. Only the references are kept until the
+ * whole document is in. */
+struct dump_stream_state {
+	unsigned int active:1;
+
+	/* What the line being looked at holds so far */
+	unsigned int line_empty:1;
+	unsigned int line_frame:1;
+
+	/* Whether the source is UTF-8, and the byte the character being
+	 * looked at starts with */
+	unsigned int utf8:1;
+	unsigned char lead;
+
+	/* The source is dumped up to @pos and looked at up to @scanned. A
+	 * piece may end at @piece_end, after the last break found. */
+	off_t pos;
+	off_t scanned;
+	off_t piece_end;
+
+	int links;
+	struct string references;
+};
+
+static struct dump_stream_state dump_stream_state;
+
+static int
+can_stream_dump(struct cache_entry *cached)
+{
+	if (!dump_as_plain_text(cached))
+		return 0;
+
+	/* Compressed documents are only decoded once complete. */
+	if (cached->uri->protocol != PROTOCOL_FILE) {
+		char *extension = get_extension_from_uri(cached->uri);
+
+		if (extension) {
+			int encoded = guess_encoding(extension) != ENCODING_NONE;
+
+			mem_free(extension);
+			if (encoded) return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+init_dump_stream(struct dump_stream_state *stream, struct cache_entry *cached,
+		 struct document_options *options)
+{
+	enum cp_status cp_status;
+	int cp;
+
+	memset(stream, 0, sizeof(*stream));
+	if (!init_string(&stream->references))
+		return 0;
+
+	get_convert_table(empty_string_or_(cached->head), options->cp,
+			  options->assume_cp, &cp, &cp_status,
+			  options->hard_assume);
+	stream->utf8 = is_cp_utf8(cp);
+	stream->line_empty = 1;
+	stream->active = 1;
+
+	return 1;
+}
+
+/* Whether fixup_tables() could join the character @c into a frame with the
+ * line below. Besides '+' and '|', it looks for the BORDER_* characters,
+ * which lie from BORDER_SVLINE to BORDER_SULCORNER. */
+static inline int
+is_dump_stream_frame_char(unicode_val_T c)
+{
+	return c == '+' || c == '|'
+	       || (c >= BORDER_SVLINE && c <= BORDER_SULCORNER);
+}
+
+/* Looks for breaks in what of @cached was loaded since the last time. The
+ * plain text renderer lays out the lines after a break the same way when it
+ * starts afresh there. An empty line would break the compression of empty
+ * lines, and with @fixup_tables nothing that could be joined into a frame
+ * with the line below may be on it. */
+static void
+scan_dump_stream(struct dump_stream_state *stream, struct cache_entry *cached,
+		 int fixup_tables)
+{
+	struct fragment *frag;
+
+	foreach (frag, cached->frag) {
+		off_t d = stream->scanned - frag->offset;
+
+		if (d < 0) break;
+
+		for (; d < frag->length; d++, stream->scanned++) {
+			unsigned char c = frag->data[d];
+			unicode_val_T data = c;
+
+			if (c == ASCII_LF) {
+				if (!stream->line_empty && !stream->line_frame)
+					stream->piece_end = stream->scanned + 1;
+				stream->line_empty = 1;
+				stream->line_frame = 0;
+				continue;
+			}
+
+			if (!isspace(c))
+				stream->line_empty = 0;
+
+			/* Only U+00B3 to U+00DA, which take two bytes,
+			 * could be frame characters in UTF-8. */
+			if (stream->utf8 && c >= 0x80) {
+				if (c >= 0xC0) {
+					stream->lead = c;
+					continue;
+				}
+
+				data = (stream->lead & 0xE0) == 0xC0
+				       ? ((stream->lead & 0x1F) << 6) | (c & 0x3F)
+				       : 0x80;
+				stream->lead = 0;
+			}
+
+			if (fixup_tables && is_dump_stream_frame_char(data))
+				stream->line_frame = 1;
+		}
+	}
+}
+
+/*! Dumps the complete lines of @cached loaded past what @stream dumped so far
+ * onto @fd, or to @string if @fd is -1, or all of what is left if @final.
+ * @return 0 on success, -1 on error */
+static int
+dump_stream(struct dump_stream_state *stream, int fd, struct string *string,
+	    struct download *download, struct cache_entry *cached,
+	    struct dump_settings *settings, int final)
+{
+	struct document_options o;
+	struct document *document;
+	struct dump_output *out;
+	struct fragment *frag;
+	struct string chunk;
+	off_t length;
+	int error = 0;
+
+	init_dump_options(&o, settings);
+	o.plain = 1;
+
+	if (!stream->active && !init_dump_stream(stream, cached, &o))
+		return -1;
+
+	/* The last line may still grow unless this is the end, and the
+	 * piece may only end on a break. */
+	scan_dump_stream(stream, cached, o.plain_fixup_tables);
+	length = (final ? stream->scanned : stream->piece_end) - stream->pos;
+	if (length <= 0) return 0;
+
+	if (!init_string(&chunk)) return -1;
+
+	foreach (frag, cached->frag) {
+		off_t d = stream->pos + chunk.length - frag->offset;
+
+		if (d < 0 || chunk.length == length) break;
+		if (d < frag->length)
+			add_bytes_to_string(&chunk, frag->data + d,
+					    int_min(frag->length - d,
+						    length - chunk.length));
+	}
+
+	document = init_document(cached, &o);
+	if (!document) {
+		done_string(&chunk);
+		return -1;
+	}
+
+	render_plain_document(cached, document, &chunk);
+	sort_links(document);
+	done_string(&chunk);
+
+	out = dump_output_alloc(fd, string, document->options.cp);
+	if (out) {
+		error = dump_document(document, out);
+		mem_free(out);
+	} else {
+		error = -1;
+	}
+
+	if (!error && document->nlinks
+	    && get_opt_bool("document.dump.references", NULL)) {
+		out = dump_output_alloc(-1, &stream->references,
+					document->options.cp);
+		if (out) {
+			dump_link_references(document, out, stream->links);
+			mem_free(out);
+		}
+	}
+	stream->links += document->nlinks;
+
+	object_unlock(document);
+	done_document(document);
+
+	stream->pos += length;
+	detach_connection(download, stream->pos, 0);
+
+	return error;
+}
+
+/* Writes the references collected while streaming onto @fd, or to @string
+ * if @fd is -1, and resets the state. */
+static void
+done_dump_stream(struct dump_stream_state *stream, int fd,
+		 struct string *string)
+{
+	if (!stream->active) return;
+
+	if (stream->references.length) {
+		char *header = DUMP_REFERENCES_HEADER;
+
+		if (string) {
+			add_to_string(string, header);
+			add_string_to_string(string, &stream->references);
+		} else if (hard_write(fd, header, strlen(header)) >= 0) {
+			hard_write(fd, stream->references.source,
+				   stream->references.length);
+		}
+	}
+
+	done_string(&stream->references);
+	stream->active = 0;
+}
+
+#undef D_BUF
+
+/* This dumps the given @cached's source onto @fd nothing more. It returns 0 if it
+ * all went fine and 1 if something isn't quite right and we should terminate
+ * ourselves ASAP. */
+static int
+dump_source(int fd, struct download *download, struct cache_entry *cached)
+{
+	struct fragment *frag;
+
+	if (!cached) return 0;
+
+nextfrag:
+	foreach (frag, cached->frag) {
+		int d = dump_pos - frag->offset;
+		int l, w;
+
+		if (d < 0 || frag->length <= d)
+			continue;
+
+		l = frag->length - d;
+		w = hard_write(fd, frag->data + d, l);
+
+		if (w != l) {
+			detach_connection(download, dump_pos, 0);
+
+			if (w < 0)
+				ERROR(gettext("Can't write to stdout: %s"),
+				      (char *) strerror(errno));
+			else
+				ERROR(gettext("Can't write to stdout."));
+
+			program.retval = RET_ERROR;
+			return 1;
+		}
+
+		dump_pos += w;
+		detach_connection(download, dump_pos, 0);
+		goto nextfrag;
+	}
+
+	return 0;
+}
+
+static char *
+subst_url(char *str, struct string *url)
+{
+	struct string string;
+
+	if (!init_string(&string)) return NULL;
+
+	while (*str) {
+		int p;
+
+		for (p = 0; str[p] && str[p] != '%' && str[p] != '\\'; p++);
+
+		add_bytes_to_string(&string, str, p);
+		str += p;
+
+		if (*str == '\\') {
+			unsigned char ch;
+
+			str++;
+			switch (*str) {
+				case 'f':
+					ch = '\f';
+					break;
+				case 'n':
+					ch = '\n';
+					break;
+				case 't':
+					ch = '\t';
+					break;
+				default:
+					ch = *str;
+			}
+			if (*str) {
+				add_char_to_string(&string, ch);
+				str++;
+			}
+			continue;
+
+		} else if (*str != '%') {
+			break;
+		}
+
+		str++;
+		switch (*str) {
+			case 'u':
+				if (url) add_string_to_string(&string, url);
+				break;
+		}
+
+		if (*str) str++;
+	}
+
+	return string.source;
+}
+
+static void
+dump_print(char *option, struct string *url)
+{
+	char *str = get_opt_str(option, NULL);
+
+	if (str) {
+		char *realstr = subst_url(str, url);
+
+		if (realstr) {
+			printf("%s", realstr);
+			fflush(stdout);
+			mem_free(realstr);
+		}
+	}
+}
+
+static void
+dump_print_separator(void)
+{
+	/* The jsonl records tell where each document starts. */
+	if (get_cmd_opt_bool("dump") && is_jsonl_dump())
+		return;
+
+	dump_print("document.dump.separator", NULL);
+}
+
+static void
+dump_loading_callback(struct download *download, void *p)
+{
+	struct cache_entry *cached = download->cached;
+	int fd = get_output_handle();
+
+	if (fd == -1) return;
+	if (cached && cached->redirect && dump_redir_count++ < MAX_REDIRECTS) {
+		struct uri *uri = cached->redirect;
+
+		cancel_download(download, 0);
+
+		load_uri(uri, cached->uri, download, PRI_MAIN, 0, -1);
+		return;
+	}
+
+	if (is_in_queued_state(download->state)) return;
+
+	if (get_cmd_opt_bool("dump")) {
+		struct dump_settings settings;
+
+		get_dump_settings(&settings);
+
+		if (is_in_transfering_state(download->state)) {
+			if (!cached || (!dump_stream_state.active
+					&& !can_stream_dump(cached)))
+				return;
+
+			if (!dump_stream(&dump_stream_state, fd, NULL, download,
+					 cached, &settings, 0))
+				return;
+
+			ERROR(gettext("Can't write to stdout."));
+			program.retval = RET_ERROR;
+			done_dump_stream(&dump_stream_state, fd, NULL);
+			goto terminate;
+		}
+
+		if (dump_stream_state.active) {
+			dump_stream(&dump_stream_state, fd, NULL, download,
+				    cached, &settings, 1);
+			done_dump_stream(&dump_stream_state, fd, NULL);
+		} else {
+			dump_formatted(fd, NULL, download, cached, &settings);
+		}
+
+	} else {
+		if (dump_source(fd, download, cached) > 0)
+			goto terminate;
+
+		if (is_in_progress_state(download->state))
+			return;
+
+	}
+
+	if (!is_in_state(download->state, S_OK)) {
+		usrerror(get_state_message(download->state, NULL));
+		program.retval = RET_ERROR;
+		goto terminate;
+	}
+
+terminate:
+	program.terminate = 1;
+	dump_next(NULL);
+}
+
+static void
+dump_start(char *url)
+{
+	char *wd = get_cwd();
+	struct uri *uri = get_translated_uri(url, wd);
+
+	mem_free_if(wd);
+
+	if (!uri || get_protocol_external_handler(NULL, uri)) {
+		usrerror(gettext("URL protocol not supported (%s)."), url);
+		goto terminate;
+	}
+
+	dump_download.callback = (download_callback_T *) dump_loading_callback;
+	dump_pos = 0;
+
+	if (load_uri(uri, NULL, &dump_download, PRI_MAIN, 0, -1)) {
+terminate:
+		dump_next(NULL);
+		program.terminate = 1;
+		program.retval = RET_SYNTAX;
+	}
+
+	if (uri) done_uri(uri);
+}
+
+static void dump_parallel_next(void);
+
+static void
+dump_parallel_loading_callback(struct download *download,
+			       struct dump_request *request)
+{
+	struct cache_entry *cached = download->cached;
+
+	if (cached && cached->redirect && request->redir_count++ < MAX_REDIRECTS) {
+		struct uri *uri = cached->redirect;
+
+		cancel_download(download, 0);
+
+		load_uri(uri, cached->uri, download, PRI_MAIN, 0, -1);
+		return;
+	}
+
+	if (is_in_queued_state(download->state)) return;
+
+	if (get_cmd_opt_bool("dump")) {
+		struct dump_settings settings;
+
+		if (is_in_transfering_state(download->state))
+			return;
+
+		get_dump_settings(&settings);
+		dump_formatted(-1, &request->output, download, cached, &settings);
+
+	} else {
+		struct fragment *fragment;
+
+		if (is_in_progress_state(download->state))
+			return;
+
+		fragment = cached ? get_cache_fragment(cached) : NULL;
+		if (fragment)
+			add_bytes_to_string(&request->output, fragment->data,
+					    fragment->length);
+	}
+
+	if (!is_in_state(download->state, S_OK)) {
+		usrerror(get_state_message(download->state, NULL));
+		program.retval = RET_ERROR;
+	}
+
+	request->done = 1;
+	dump_parallel_next();
+}
+
+static void
+dump_parallel_start(struct string_list_item *item)
+{
+	struct dump_request *request = mem_calloc(1, sizeof(*request));
+	char *wd;
+	struct uri *uri;
+
+	if (!request || !init_string(&request->output)) {
+		mem_free_if(request);
+		program.retval = RET_ERROR;
+		return;
+	}
+
+	request->item = item;
+	request->download.callback = (download_callback_T *) dump_parallel_loading_callback;
+	request->download.data = request;
+	add_to_list_end(dump_requests, request);
+
+	wd = get_cwd();
+	uri = get_translated_uri(item->string.source, wd);
+	mem_free_if(wd);
+
+	if (!uri || get_protocol_external_handler(NULL, uri)) {
+		usrerror(gettext("URL protocol not supported (%s)."),
+			 item->string.source);
+		program.retval = RET_SYNTAX;
+		request->done = 1;
+
+	} else if (load_uri(uri, NULL, &request->download, PRI_MAIN, 0, -1)) {
+		program.retval = RET_SYNTAX;
+		request->done = 1;
+	}
 
 	if (uri) done_uri(uri);
 }
 
+static void
+dump_parallel_write(struct dump_request *request)
+{
+	static int first = 1;
+	int fd = get_output_handle();
+
+	if (!first) {
+		dump_print_separator();
+	} else {
+		first = 0;
+	}
+
+	dump_print("document.dump.header", &request->item->string);
+	if (fd != -1 && request->output.length
+	    && hard_write(fd, request->output.source, request->output.length)
+	       != request->output.length) {
+		ERROR(gettext("Can't write to stdout."));
+		program.retval = RET_ERROR;
+	}
+	dump_print("document.dump.footer", &request->item->string);
+}
+
+/* Writes out the finished requests at the front of the window and refills
+ * it with new loads from the todo list. Loads can finish right away, from
+ * inside load_uri(), which calls back here; the outer call then simply
+ * picks them up on its next round. */
+static void
+dump_parallel_next(void)
+{
+	static int busy;
+	int parallel = get_opt_int("document.dump.parallel", NULL);
+	int progress;
+
+	if (busy) return;
+	busy = 1;
+
+	do {
+		progress = 0;
+
+		while (!list_empty(dump_requests)) {
+			struct dump_request *request = dump_requests.next;
+
+			if (!request->done) break;
+
+			del_from_list(request);
+			dump_parallel_write(request);
+			done_string(&request->output);
+			mem_free(request);
+			progress = 1;
+		}
+
+		while (!list_empty(todo_list)
+		       && list_size(&dump_requests) < parallel) {
+			struct string_list_item *item = todo_list.next;
+
+			del_from_list(item);
+			add_to_list(done_list, item);
+			dump_parallel_start(item);
+			progress = 1;
+		}
+	} while (progress);
+
+	busy = 0;
+
+	if (list_empty(dump_requests)) {
+		free_string_list(&done_list);
+		program.terminate = 1;
+	}
+}
+
 void
 dump_next(LIST_OF(struct string_list_item) *url_list)
 {
-	static INIT_LIST_OF(struct string_list_item, todo_list);
-	static INIT_LIST_OF(struct string_list_item, done_list);
 	struct string_list_item *item;
 
 	if (url_list) {
@@ -664,6 +1484,12 @@ dump_next(LIST_OF(struct string_list_item) *url_list)
 			del_from_list(item);
 			add_to_list_end(todo_list, item);
 		}
+
+		if (get_opt_int("document.dump.parallel", NULL) > 1) {
+			program.terminate = 0;
+			dump_parallel_next();
+			return;
+		}
 	}
 
 	/* Dump each url list item one at a time */
@@ -677,7 +1503,7 @@ dump_next(LIST_OF(struct string_list_item) *url_list)
 		add_to_list(done_list, item);
 
 		if (!first) {
-			dump_print("document.dump.separator", NULL);
+			dump_print_separator();
 		} else {
 			first = 0;
 		}
@@ -695,6 +1521,391 @@ dump_next(LIST_OF(struct string_list_item) *url_list)
 	}
 }
 
+/* The dump server (-dump-server) keeps one process, with its document
+ * cache, DNS cache and keep-alive connections, around for many dumps.
+ * A client connects to its socket and sends a single request line:
+ *
+ *	URL [TAB width [TAB codepage [TAB color mode]]] LF
+ *
+ * Empty or missing fields default to the document.dump options. The server
+ * answers with a status line, "OK" or "ERROR <message>", followed by the
+ * formatted document, and closes the connection. The URL is translated by
+ * the client, since the server has its own working directory.
+ *
+ * The reply is queued and written without blocking, so that a client that
+ * reads slowly does not hold up the others. Plain text that can be dumped
+ * while it loads is sent a piece at a time, and a status line of "OK" then
+ * only means that the loading started. The connection is closed early if it
+ * fails later. */
+struct dump_client {
+	LIST_HEAD(struct dump_client);
+
+	int fd;
+	struct string request;
+	struct download download;
+	struct dump_settings settings;
+	struct dump_stream_state stream;
+	int redir_count;
+
+	/* What of the reply is not written yet starts at @reply_written.
+	 * Once it is all queued, @replied is set. */
+	struct string reply;
+	int reply_written;
+	unsigned int replied:1;
+};
+
+static INIT_LIST_OF(struct dump_client, dump_clients);
+
+static void
+done_dump_client(struct dump_client *client)
+{
+	if (is_in_progress_state(client->download.state)
+	    && client->download.conn)
+		cancel_download(&client->download, 0);
+
+	clear_handlers(client->fd);
+	close(client->fd);
+	done_string(&client->request);
+	done_string(&client->reply);
+	if (client->stream.active)
+		done_string(&client->stream.references);
+	del_from_list(client);
+	mem_free(client);
+}
+
+static void
+dump_client_write(struct dump_client *client)
+{
+	int w = safe_write(client->fd, client->reply.source + client->reply_written,
+			   client->reply.length - client->reply_written);
+
+	if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return;
+
+	if (w <= 0) {
+		done_dump_client(client);
+		return;
+	}
+
+	client->reply_written += w;
+	if (client->reply_written < client->reply.length)
+		return;
+
+	if (client->replied) {
+		done_dump_client(client);
+		return;
+	}
+
+	/* Wait for the next piece, reusing the buffer. */
+	client->reply.length = client->reply_written = 0;
+	set_handlers(client->fd, NULL, NULL,
+		     (select_handler_T) done_dump_client, client);
+}
+
+/* Starts sending what of the reply is queued, all of it if @replied. The
+ * client is freed once the whole reply is sent. */
+static void
+dump_client_send(struct dump_client *client, int replied)
+{
+	client->replied = replied;
+
+	if (client->reply_written == client->reply.length) {
+		if (replied) done_dump_client(client);
+		return;
+	}
+
+	set_handlers(client->fd, NULL, (select_handler_T) dump_client_write,
+		     (select_handler_T) done_dump_client, client);
+}
+
+static void
+dump_client_reply(struct dump_client *client, char *status, char *message)
+{
+	add_to_string(&client->reply, status);
+	if (message) {
+		add_char_to_string(&client->reply, ' ');
+		add_to_string(&client->reply, message);
+	}
+	add_char_to_string(&client->reply, '\n');
+}
+
+static void
+dump_client_loading_callback(struct download *download,
+			     struct dump_client *client)
+{
+	struct cache_entry *cached = download->cached;
+
+	if (cached && cached->redirect && client->redir_count++ < MAX_REDIRECTS) {
+		struct uri *uri = cached->redirect;
+
+		cancel_download(download, 0);
+
+		load_uri(uri, cached->uri, download, PRI_MAIN, 0, -1);
+		return;
+	}
+
+	if (is_in_queued_state(download->state))
+		return;
+
+	if (is_in_transfering_state(download->state)) {
+		if (!cached || (!client->stream.active
+				&& !can_stream_dump(cached)))
+			return;
+
+		if (!client->stream.active)
+			dump_client_reply(client, "OK", NULL);
+
+		if (dump_stream(&client->stream, -1, &client->reply, download,
+				cached, &client->settings, 0)) {
+			done_dump_client(client);
+			return;
+		}
+
+		dump_client_send(client, 0);
+		return;
+	}
+
+	if (client->stream.active) {
+		/* Only the status line can tell about errors. */
+		if (!is_in_state(download->state, S_OK)) {
+			done_dump_client(client);
+			return;
+		}
+
+		dump_stream(&client->stream, -1, &client->reply, download,
+			    cached, &client->settings, 1);
+		done_dump_stream(&client->stream, -1, &client->reply);
+
+	} else if (is_in_state(download->state, S_OK)) {
+		dump_client_reply(client, "OK", NULL);
+		dump_formatted(-1, &client->reply, download, cached,
+			       &client->settings);
+	} else {
+		dump_client_reply(client, "ERROR",
+				  get_state_message(download->state, NULL));
+	}
+
+	dump_client_send(client, 1);
+}
+
+/* Parses the request line and starts loading the document. */
+static void
+dump_client_start(struct dump_client *client)
+{
+	char *field[4] = { NULL };
+	char *pos = client->request.source;
+	char *wd;
+	struct uri *uri;
+	int i;
+
+	for (i = 0; i < 4 && pos; i++) {
+		field[i] = pos;
+		pos = strchr(pos, '\t');
+		if (pos) *pos++ = '\0';
+	}
+
+	get_dump_settings(&client->settings);
+	if (field[1] && *field[1]) {
+		client->settings.width = atoi(field[1]);
+		int_bounds(&client->settings.width, 1, 65536);
+	}
+	if (field[2] && *field[2] && get_cp_index(field[2]) >= 0)
+		client->settings.codepage = get_cp_index(field[2]);
+	if (field[3] && *field[3]) {
+		client->settings.color_mode = atoi(field[3]);
+		int_bounds(&client->settings.color_mode, -1, COLOR_MODES - 1);
+	}
+
+	wd = get_cwd();
+	uri = get_translated_uri(field[0], wd);
+	mem_free_if(wd);
+
+	if (!uri || get_protocol_external_handler(NULL, uri)) {
+		dump_client_reply(client, "ERROR",
+				  gettext("URL protocol not supported"));
+		if (uri) done_uri(uri);
+		dump_client_send(client, 1);
+		return;
+	}
+
+	client->download.callback = (download_callback_T *) dump_client_loading_callback;
+	client->download.data = client;
+	/* The server lives long, so honour expiry of cached documents. The
+	 * callback is called, and frees @client, even if load_uri() fails,
+	 * possibly before it returns. */
+	load_uri(uri, NULL, &client->download, PRI_MAIN, CACHE_MODE_NORMAL, -1);
+	done_uri(uri);
+}
+
+static void
+dump_client_read(struct dump_client *client)
+{
+	char buf[1024];
+	char *end;
+	int r = safe_read(client->fd, buf, sizeof(buf));
+
+	if (r <= 0 || !add_bytes_to_string(&client->request, buf, r)
+	    || client->request.length > MAX_STR_LEN) {
+		done_dump_client(client);
+		return;
+	}
+
+	end = memchr(client->request.source, '\n', client->request.length);
+	if (!end) return;
+
+	*end = '\0';
+	if (end > client->request.source && end[-1] == '\r')
+		end[-1] = '\0';
+
+	clear_handlers(client->fd);
+	if (set_nonblocking_fd(client->fd) < 0) {
+		done_dump_client(client);
+		return;
+	}
+
+	dump_client_start(client);
+}
+
+static void
+dump_server_connection(int fd)
+{
+	struct dump_client *client = mem_calloc(1, sizeof(*client));
+
+	if (!client || !init_string(&client->request)) {
+		mem_free_if(client);
+		close(fd);
+		return;
+	}
+
+	if (!init_string(&client->reply)) {
+		done_string(&client->request);
+		mem_free(client);
+		close(fd);
+		return;
+	}
+
+	client->fd = fd;
+	add_to_list(dump_clients, client);
+	set_handlers(fd, (select_handler_T) dump_client_read, NULL,
+		     (select_handler_T) done_dump_client, client);
+}
+
+int
+init_dump_server(void)
+{
+	return init_dump_interlink(dump_server_connection);
+}
+
+/* Dumps the URLs through a running dump server. Returns 0 if there is no
+ * dump server to talk to, else 1 once all URLs have been dumped. */
+int
+dump_to_server(LIST_OF(struct string_list_item) *url_list)
+{
+	struct string_list_item *item;
+	struct dump_settings settings;
+	int fd = get_output_handle();
+	int first = 1;
+
+	if (fd == -1) return 0;
+
+	get_dump_settings(&settings);
+
+	foreach (item, *url_list) {
+		struct string request, status;
+		char buf[4096];
+		int server = connect_dump_interlink();
+		int in_status = 1;
+		char *wd;
+		struct uri *uri;
+		int r;
+
+		if (server == -1) {
+			/* Only fall back to dumping locally if nothing has
+			 * been dumped yet. */
+			if (first) return 0;
+			program.retval = RET_ERROR;
+			break;
+		}
+
+		/* Relative paths are relative to our working directory, not
+		 * that of the server. */
+		wd = get_cwd();
+		uri = get_translated_uri(item->string.source, wd);
+		mem_free_if(wd);
+
+		if (!uri || strpbrk(struri(uri), "\t\r\n")) {
+			usrerror(gettext("URL protocol not supported (%s)."),
+				 item->string.source);
+			program.retval = RET_SYNTAX;
+			if (uri) done_uri(uri);
+			close(server);
+			continue;
+		}
+
+		if (!first) {
+			dump_print_separator();
+		} else {
+			first = 0;
+		}
+		dump_print("document.dump.header", &item->string);
+
+		if (init_string(&request)) {
+			add_to_string(&request, struri(uri));
+			add_format_to_string(&request, "\t%d\t%s\t%d\n",
+					     settings.width,
+					     get_cp_config_name(settings.codepage),
+					     settings.color_mode);
+			hard_write(server, request.source, request.length);
+			done_string(&request);
+		}
+		done_uri(uri);
+
+		/* Report the status line on errors and copy the rest to
+		 * the output. */
+		if (!init_string(&status)) {
+			close(server);
+			program.retval = RET_ERROR;
+			break;
+		}
+
+		while ((r = safe_read(server, buf, sizeof(buf))) > 0) {
+			char *data = buf;
+
+			if (in_status) {
+				char *end = memchr(buf, '\n', r);
+				int len = end ? end - buf : r;
+
+				add_bytes_to_string(&status, buf, len);
+				if (!end) continue;
+
+				if (strcmp(status.source, "OK")) {
+					usrerror("%s", !strncmp(status.source, "ERROR ", 6)
+						       ? status.source + 6 : status.source);
+					program.retval = RET_ERROR;
+				}
+				in_status = 0;
+				r -= len + 1;
+				data = end + 1;
+			}
+
+			if (r > 0 && hard_write(fd, data, r) != r) {
+				program.retval = RET_ERROR;
+				break;
+			}
+		}
+		if (in_status) {
+			usrerror(gettext("The dump server closed the connection."));
+			program.retval = RET_ERROR;
+		}
+		done_string(&status);
+		close(server);
+
+		dump_print("document.dump.footer", &item->string);
+	}
+
+	return 1;
+}
+
 struct string *
 add_document_to_string(struct string *string, struct document *document)
 {
@@ -707,6 +1918,7 @@ add_document_to_string(struct string *string, struct document *document)
 	out = dump_output_alloc(-1, string, document->options.cp);
 	if (!out) return NULL;
 
+	render_plain_lines(document, 0, document->height);
 	error = dump_nocolor(document, out);
 
 	mem_free(out);
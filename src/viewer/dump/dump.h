@@ -17,6 +17,8 @@ add_document_to_string(struct string *string, struct document *document);
 
 int dump_to_file(struct document *, int);
 void dump_next(LIST_OF(struct string_list_item) *);
+int init_dump_server(void);
+int dump_to_server(LIST_OF(struct string_list_item) *);
 
 #ifdef __cplusplus
 }
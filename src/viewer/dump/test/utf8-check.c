@@ -0,0 +1,44 @@
+/* Check that the standard input is valid UTF-8 */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elinks.h"
+
+#include "intl/charsets.h"
+#include "util/test.h"
+
+int
+main(int argc, char **argv)
+{
+	static char buffer[65536];
+	size_t length = fread(buffer, 1, sizeof(buffer), stdin);
+	char *pos = buffer;
+	char *end = buffer + length;
+
+	if (!feof(stdin))
+		die("input longer than %d bytes", (int) sizeof(buffer));
+
+	while (pos < end) {
+		unsigned char c = *pos;
+		char *start = pos;
+		unicode_val_T u;
+
+		if (c < 0x80) {
+			pos++;
+			continue;
+		}
+
+		u = utf8_to_unicode(&pos, end);
+		if (u == UCS_NO_CHAR || u == UCS_REPLACEMENT_CHARACTER)
+			die("invalid UTF-8 at byte %d", (int) (start - buffer));
+	}
+
+	return 0;
+}
@@ -19,6 +19,7 @@
 #include "document/html/frames.h"
 #include "document/html/iframes.h"
 #include "document/options.h"
+#include "document/plain/renderer.h"
 #include "document/refresh.h"
 #include "document/renderer.h"
 #include "document/view.h"
@@ -390,6 +391,7 @@ draw_doc(struct session *ses, struct document_view *doc_view, int active)
 		if (ses->navigate_mode == NAVIGATE_LINKWISE)
 			check_vs(doc_view);
 	}
+	render_plain_lines(doc_view->document, vy, vy + box->height);
 	for (y = int_max(vy, 0);
 	     y < int_min(doc_view->document->height, box->height + vy);
 	     y++) {
@@ -27,6 +27,7 @@
 #include "bfu/dialog.h"
 #include "config/kbdbind.h"
 #include "document/document.h"
+#include "document/plain/renderer.h"
 #include "document/view.h"
 #include "intl/charsets.h"
 #include "intl/libintl.h"
@@ -152,12 +153,21 @@ get_srch(struct document *document)
 	if_assert_failed return 0;
 
 	foreachback (node, document->nodes) {
-		int x, y;
+		int x, y = node->box.y;
 		int height = int_min(node->box.y + node->box.height, document->height);
 
-		for (y = node->box.y; y < height; y++) {
-			int width = int_min(node->box.x + node->box.width,
-			                    document->data[y].length);
+		/* Big plain text is only searched here where it is laid out,
+		 * find_next_plain_line() looks for the rest in the source. */
+		if (document->plain_index) {
+			int_lower_bound(&y, document->plain_index->from);
+			int_upper_bound(&height, document->plain_index->to);
+		}
+
+		for (; y < height; y++) {
+			int width;
+
+			width = int_min(node->box.x + node->box.width,
+			                document->data[y].length);
 
 			for (x = node->box.x;
 			     x < width && document->data[y].chars[x].data <= ' ';
@@ -546,7 +556,8 @@ is_in_range_plain(struct document *document, int y, int height,
 	int yy = y + height;
 	UCHAR *txt;
 	int found = 0;
-	int case_sensitive = get_opt_bool("document.browse.search.case", NULL);
+	static struct option_handle case_opt = INIT_OPTION_HANDLE("document.browse.search.case");
+	int case_sensitive = get_opt_bool_handle(&case_opt);
 
 	txt = case_sensitive ? memacpy_u(text, textlen, utf8) : lowered_string(text, textlen, utf8);
 	if (!txt) return -1;
@@ -635,7 +646,8 @@ get_searched_plain(struct document_view *doc_view, struct point **pt, int *pl,
 	struct el_box *box;
 	int xoffset, yoffset;
 	int len = 0;
-	int case_sensitive = get_opt_bool("document.browse.search.case", NULL);
+	static struct option_handle case_opt = INIT_OPTION_HANDLE("document.browse.search.case");
+	int case_sensitive = get_opt_bool_handle(&case_opt);
 
 	txt = case_sensitive ? memacpy_u(*doc_view->search_word, l, utf8)
 			     : lowered_string(*doc_view->search_word, l, utf8);
@@ -700,7 +712,8 @@ get_searched_plain_all(struct document_view *doc_view, struct point **pt, int *p
 	UCHAR *txt;
 	struct point *points = NULL;
 	int len = 0;
-	int case_sensitive = get_opt_bool("document.browse.search.case", NULL);
+	static struct option_handle case_opt = INIT_OPTION_HANDLE("document.browse.search.case");
+	int case_sensitive = get_opt_bool_handle(&case_opt);
 
 	txt = case_sensitive ? memacpy_u(*doc_view->search_word, l, utf8)
 			     : lowered_string(*doc_view->search_word, l, utf8);
@@ -944,6 +957,211 @@ static enum find_error find_next_do(struct session *ses,
 
 static void print_find_error(struct session *ses, enum find_error find_error);
 
+/** Big plain text is searched in the source, one line at a time, and only
+ * the lines with a match are laid out. Matches spanning lines are not
+ * found there. */
+struct plain_line_search {
+	UCHAR *pattern;
+	int length;
+	int case_sensitive;
+	int utf8;
+#ifdef CONFIG_TRE
+	int use_regex;
+	regex_t regex;
+#endif
+
+	/* Where all the matches go, or NULL to stop at the first one */
+	struct point **points;
+	int *npoints;
+};
+
+static enum find_error
+init_plain_line_search(struct plain_line_search *search, char *text,
+		       int utf8)
+{
+	static struct option_handle case_opt = INIT_OPTION_HANDLE("document.browse.search.case");
+
+	memset(search, 0, sizeof(*search));
+	search->case_sensitive = get_opt_bool_handle(&case_opt);
+	search->utf8 = utf8;
+	search->length = strlen_u(text, utf8);
+
+#ifdef CONFIG_TRE
+	search->use_regex = !!get_opt_int("document.browse.search.regex", NULL);
+	if (search->use_regex) {
+		search->pattern = memacpy_u(text, search->length, utf8);
+		if (!search->pattern) return FIND_ERROR_MEMORY;
+
+		if (!init_regex(&search->regex, search->pattern)) {
+			mem_free(search->pattern);
+			return FIND_ERROR_REGEX;
+		}
+
+		return FIND_ERROR_NONE;
+	}
+#endif
+
+	search->pattern = search->case_sensitive
+			? memacpy_u(text, search->length, utf8)
+			: lowered_string(text, search->length, utf8);
+
+	return search->pattern ? FIND_ERROR_NONE : FIND_ERROR_MEMORY;
+}
+
+static void
+done_plain_line_search(struct plain_line_search *search)
+{
+#ifdef CONFIG_TRE
+	if (search->use_regex)
+		tre_regfree(&search->regex);
+#endif
+	mem_free(search->pattern);
+}
+
+/** Notes a match at column @a x of line @a y. Returns whether the search
+ * is over. */
+static int
+add_plain_line_match(struct plain_line_search *search, int x, int y)
+{
+	if (!search->points) return 1;
+
+	if (realloc_points(search->points, *search->npoints)) {
+		(*search->points)[*search->npoints].x = x;
+		(*search->points)[(*search->npoints)++].y = y;
+	}
+
+	return 0;
+}
+
+/** Looks for the search pattern in the @a text of line @a y, spaced out
+ * the way get_srch() sees it once laid out. */
+static int
+match_plain_line(void *data, int y, char *text, int length)
+{
+	struct plain_line_search *search = data;
+	int utf8 = search->utf8;
+	int case_sensitive = search->case_sensitive;
+	int textlen = strlen_u(text, utf8);
+	UCHAR *line = memacpy_u(text, textlen, utf8);
+	UCHAR *chars;
+	int *cols;
+	int i, n = 0, x = 0, found = 0;
+
+	if (!line) return 0;
+
+	/* Tabs take up to eight cells. */
+	chars = mem_alloc((textlen * 8 + 1) * sizeof(*chars));
+	cols = mem_alloc((textlen * 8 + 1) * sizeof(*cols));
+	if (!chars || !cols) {
+		mem_free_if(chars);
+		mem_free_if(cols);
+		mem_free(line);
+		return 0;
+	}
+
+	for (i = 0; i < textlen; i++) {
+		UCHAR c = line[i];
+
+		if (c == ASCII_TAB) {
+			do {
+				if (n) {
+					chars[n] = ' ';
+					cols[n++] = x;
+				}
+			} while (++x & 7);
+			continue;
+		}
+
+		/* Blanks which start the line and other controls are left
+		 * out. */
+		if (c < ' ' || (c == ' ' && !n)) {
+			if (c == ' ') x++;
+			continue;
+		}
+
+#ifdef CONFIG_UTF8
+		if (c == 0xA0) c = ' ';
+#endif
+		chars[n] = c;
+		cols[n++] = x;
+#ifdef CONFIG_UTF8
+		if (utf8) {
+			x += unicode_to_cell(line[i]);
+			continue;
+		}
+#endif
+		x++;
+	}
+	chars[n] = 0;
+
+#ifdef CONFIG_TRE
+	if (search->use_regex) {
+		regmatch_t regmatch;
+		int regexec_flags = 0;
+		int pos = 0;
+
+		while (pos < n && !Regexec(&search->regex, (PATTERN *)&chars[pos],
+					   1, &regmatch, regexec_flags)) {
+			regexec_flags = REG_NOTBOL;
+			if (regmatch.rm_eo == regmatch.rm_so) break;
+
+			pos += regmatch.rm_so;
+			found = 1;
+			if (add_plain_line_match(search, cols[pos], y)) break;
+			pos += regmatch.rm_eo - regmatch.rm_so;
+		}
+	} else
+#endif
+	{
+#if defined(CONFIG_UTF8) && defined(HAVE_WCTYPE_H)
+#define maybe_tolower(c) (case_sensitive ? (c) : utf8 ? towlower(c) : tolower(c))
+#else
+#define maybe_tolower(c) (case_sensitive ? (c) : tolower(c))
+#endif
+		for (i = 0; i + search->length <= n; i++) {
+			int j;
+
+			for (j = 0; j < search->length; j++)
+				if (maybe_tolower(chars[i + j]) != search->pattern[j])
+					break;
+
+			if (j < search->length) continue;
+
+			found = 1;
+			if (add_plain_line_match(search, cols[i], y)) break;
+		}
+#undef maybe_tolower
+	}
+
+	mem_free(chars);
+	mem_free(cols);
+	mem_free(line);
+
+	return found && !search->points;
+}
+
+/** get_searched_all() for big plain text */
+static enum find_error
+get_searched_plain_lines(struct document_view *doc_view, struct point **pt,
+			 int *pl, int utf8)
+{
+	struct plain_line_search search;
+	enum find_error error;
+
+	*pt = NULL;
+	*pl = 0;
+
+	error = init_plain_line_search(&search, *doc_view->search_word, utf8);
+	if (error != FIND_ERROR_NONE) return error;
+
+	search.points = pt;
+	search.npoints = pl;
+	find_plain_line(doc_view->document, 0, 1, match_plain_line, &search);
+	done_plain_line_search(&search);
+
+	return FIND_ERROR_NONE;
+}
+
 static enum find_error
 get_searched_all(struct session *ses, struct document_view *doc_view, struct point **pt, int *pl, int utf8)
 {
@@ -961,6 +1179,14 @@ get_searched_all(struct session *ses, struct document_view *doc_view, struct poi
 		if (!ses->search_word) return FIND_ERROR_MEMORY;
 	}
 
+	if (doc_view->document->plain_index) {
+		enum find_error error = get_searched_plain_lines(doc_view, pt,
+								 pl, utf8);
+
+		if (error != FIND_ERROR_NONE) return error;
+		goto searched;
+	}
+
 	get_search_data(doc_view->document);
 	l = strlen_u(*doc_view->search_word, utf8);
 
@@ -979,6 +1205,7 @@ get_searched_all(struct session *ses, struct document_view *doc_view, struct poi
 #endif
 		get_searched_plain_all(doc_view, pt, pl, l, s1, s2, utf8);
 
+searched:
 	if (*pt == NULL)
 		return FIND_ERROR_NOT_FOUND;
 
@@ -1137,6 +1364,99 @@ nt:
 	return 1;
 }
 
+/** Scrolls to the page at @a p with a match between the columns @a min
+ * and @a max. */
+static void
+show_found_page(struct document_view *doc_view, int p, int min, int max,
+		int direction)
+{
+	doc_view->vs->y = p;
+	if (max >= min)
+		doc_view->vs->x = int_min(int_max(doc_view->vs->x,
+						  max - doc_view->box.width),
+						  min);
+
+	set_link(doc_view);
+	find_next_link_in_search(doc_view, direction * 2);
+}
+
+/** find_next_do() for big plain text: the source is searched from the
+ * page at @a p on and only the page with a match is laid out. The pages
+ * are the same ones find_next_do() steps through otherwise. */
+static enum find_error
+find_next_plain_line(struct session *ses, struct document_view *doc_view,
+		     int p, int direction)
+{
+	struct document *document = doc_view->document;
+	struct plain_line_search search;
+	int height = int_max(doc_view->box.height, 1);
+	int hit_bottom = 0, hit_top = 0;
+	int y = direction > 0 ? p : p + height - 1;
+	enum find_error error;
+	int utf8 = 0;
+
+#ifdef CONFIG_UTF8
+	utf8 = document->options.utf8;
+#endif
+	error = init_plain_line_search(&search, ses->search_word, utf8);
+	if (error != FIND_ERROR_NONE) return error;
+
+	error = FIND_ERROR_NOT_FOUND;
+	if (direction < 0)
+		int_upper_bound(&y, document->height - 1);
+
+	while (1) {
+		int page, min, max, in_range;
+
+		y = find_plain_line(document, y, direction, match_plain_line,
+				    &search);
+		if (y < 0) {
+			if (hit_bottom || hit_top) break;
+
+			if (direction > 0) {
+				hit_bottom = 1;
+				p = y = 0;
+			} else {
+				hit_top = 1;
+				for (p = 0; p < document->height; p += height);
+				p -= height;
+				y = document->height - 1;
+			}
+			continue;
+		}
+
+		page = y >= p ? p + (y - p) / height * height
+			      : p - (p - y + height - 1) / height * height;
+
+		render_plain_lines(document, page, page + height);
+		get_search_data(document);
+		in_range = is_in_range(document, page, height, ses->search_word,
+				       &min, &max);
+
+		if (in_range == -1) {
+			error = FIND_ERROR_MEMORY;
+			break;
+		}
+		if (in_range == -2) {
+			error = FIND_ERROR_REGEX;
+			break;
+		}
+		if (in_range) {
+			show_found_page(doc_view, page, min, max, direction);
+			error = hit_top ? FIND_ERROR_HIT_TOP
+			      : hit_bottom ? FIND_ERROR_HIT_BOTTOM
+			      : FIND_ERROR_NONE;
+			break;
+		}
+
+		y += direction;
+	}
+
+	done_plain_line_search(&search);
+
+	return error;
+}
+
 static enum find_error
 find_next_do(struct session *ses, struct document_view *doc_view, int direction)
 {
@@ -1167,6 +1487,9 @@ find_next_do(struct session *ses, struct document_view *doc_view, int direction)
 		if (!ses->search_word) return FIND_ERROR_NONE;
 	}
 
+	if (doc_view->document->plain_index)
+		return find_next_plain_line(ses, doc_view, p, direction);
+
 	get_search_data(doc_view->document);
 
 	do {
@@ -1176,14 +1499,7 @@ find_next_do(struct session *ses, struct document_view *doc_view, int direction)
 		if (in_range == -1) return FIND_ERROR_MEMORY;
 		if (in_range == -2) return FIND_ERROR_REGEX;
 		if (in_range) {
-			doc_view->vs->y = p;
-			if (max >= min)
-				doc_view->vs->x = int_min(int_max(doc_view->vs->x,
-								  max - doc_view->box.width),
-								  min);
-
-			set_link(doc_view);
-			find_next_link_in_search(doc_view, direction * 2);
+			show_found_page(doc_view, p, min, max, direction);
 
 			if (hit_top)
 				return FIND_ERROR_HIT_TOP;
@@ -1535,6 +1851,12 @@ fixup_typeahead_match(struct session *ses, struct document_view *doc_view)
 static inline UCHAR
 get_document_char(struct document *document, int x, int y)
 {
+	struct plain_index *index = document->plain_index;
+
+	/* Lines of big plain text outside the window are not laid out. */
+	if (index && (y < index->from || y >= index->to))
+		return 0;
+
 	return (document->height > y && document->data[y].length > x)
 		? document->data[y].chars[x].data : 0;
 }
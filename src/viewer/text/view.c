@@ -25,6 +25,7 @@
 #include "document/document.h"
 #include "document/html/frames.h"
 #include "document/options.h"
+#include "document/plain/renderer.h"
 #include "document/renderer.h"
 #include "document/view.h"
 #include "intl/charsets.h"
@@ -1010,6 +1011,7 @@ copy_to_clipboard2(struct document_view *doc_view)
 	}
 
 	utf8 = document->options.utf8;
+	render_plain_lines(document, starty, endy + 1);
 
 	for (y = starty; y <= endy; y++) {
 		int ex = int_min(endx, document->data[y].length - 1);